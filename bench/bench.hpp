@@ -0,0 +1,100 @@
+#ifndef NABLA_BENCH_H
+#define NABLA_BENCH_H
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Dependency-free benchmark harness for nablagrad. Every case is run `warmup` times untimed and
+// then `reps` times timed; a result reports the median, p95 and minimum time of one iteration
+// together with the heap allocations it made (counted by the global operator new replacement
+// in bench_main.cpp). Results are written to stdout as one JSON object per line, so runs of
+// different releases can be diffed or loaded by a script.
+namespace bench {
+    // Heap allocations made so far by the process (see bench_main.cpp)
+    uint64_t allocation_count();
+    uint64_t allocated_bytes();
+
+    // Keep the compiler from optimizing away a computed value
+    template<typename T>
+    inline void do_not_optimize(const T& value) {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    struct Options {
+        size_t warmup = 3;
+        size_t reps = 20;
+        std::string filter; // only run cases whose name contains this substring
+    };
+
+    struct Result {
+        std::string name;
+        std::string params; // e.g. "n=64"
+        size_t reps;
+        double median_ns;
+        double p95_ns;
+        double min_ns;
+        double allocs_per_iter;
+        double bytes_per_iter;
+        double items_per_iter; // work units per iteration (nodes, elements, flops...), 0 if unset
+    };
+
+    inline std::ostream& operator<<(std::ostream& os, const Result& r) {
+        os << "{\"name\": \"" << r.name << "\", \"params\": \"" << r.params << "\", \"reps\": " << r.reps
+           << ", \"median_ns\": " << r.median_ns << ", \"p95_ns\": " << r.p95_ns << ", \"min_ns\": " << r.min_ns
+           << ", \"allocs_per_iter\": " << r.allocs_per_iter << ", \"bytes_per_iter\": " << r.bytes_per_iter;
+        if (r.items_per_iter > 0)
+            os << ", \"items_per_iter\": " << r.items_per_iter
+               << ", \"items_per_sec\": " << r.items_per_iter / (r.median_ns * 1e-9);
+        os << "}";
+        return os;
+    }
+
+    struct Runner {
+        explicit Runner(Options options) : m_options{std::move(options)} {}
+
+        // Time `fn`, one call being one iteration. `items` is the amount of work done by one
+        // iteration, used to report a throughput.
+        void run(const std::string& name, const std::string& params, const std::function<void()>& fn,
+                 double items = 0.) {
+            if (!this->m_options.filter.empty() && name.find(this->m_options.filter) == std::string::npos) return;
+
+            for (size_t i = 0; i < this->m_options.warmup; ++i) fn();
+
+            std::vector<double> times(this->m_options.reps);
+            uint64_t allocs0 = allocation_count(), bytes0 = allocated_bytes();
+            for (double& t : times) {
+                auto start = std::chrono::steady_clock::now();
+                fn();
+                t = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            }
+            double reps = double(times.size());
+            double allocs = double(allocation_count() - allocs0) / reps;
+            double bytes = double(allocated_bytes() - bytes0) / reps;
+
+            std::sort(times.begin(), times.end());
+            Result r{ name, params, times.size(), times[times.size() / 2],
+                      times[std::min(times.size() - 1, size_t(0.95 * reps))], times.front(), allocs, bytes, items };
+            std::cout << r << std::endl;
+            this->m_results.push_back(r);
+        }
+
+        const std::vector<Result>& results() const { return this->m_results; }
+
+    private:
+        Options m_options;
+        std::vector<Result> m_results;
+    };
+
+    // Benchmark suites, one per file
+    void gradient_benchmarks(Runner& runner);
+    void tape_benchmarks(Runner& runner);
+    void tensor_benchmarks(Runner& runner);
+} // namespace bench
+
+#endif
@@ -0,0 +1,44 @@
+#include "bench.hpp"
+
+#include <cmath>
+#include <string>
+
+#include <nablagrad/nabla.h>
+
+namespace bench {
+    // Extended Rosenbrock-like function mixing products and transcendentals, O(n) operations
+    template<typename T> T objective(const std::vector<T>& x) {
+        T sum = x.at(0) * T(0.);
+        for (size_t i = 0; i + 1 < x.size(); ++i) {
+            T d = x[i + 1] - x[i] * x[i];
+            sum = sum + d * d + sin(x[i]) * exp(x[i + 1] / T(10.));
+        }
+        return sum;
+    }
+
+    // Gradient of f:R^n->R in forward-mode (n sweeps, or n/8 with DualN<8>) and reverse-mode
+    // (one recording and one sweep) for growing n
+    void gradient_benchmarks(Runner& runner) {
+        for (size_t n : { 4, 16, 64, 256, 1024 }) {
+            std::string params = "n=" + std::to_string(n);
+            nabla::RealVec x(n);
+            for (size_t i = 0; i < n; ++i) x[i] = 0.5 + 0.01 * double(i);
+
+            auto forward = nabla::grad_forward(objective<nabla::Dual>);
+            runner.run("grad/forward", params, [&] { do_not_optimize(forward(x)); }, double(n));
+
+            auto forward8 = nabla::grad_forward<8>(objective<nabla::DualN<8>>);
+            runner.run("grad/forward_dual8", params, [&] { do_not_optimize(forward8(x)); }, double(n));
+
+            auto reverse = nabla::grad(objective<nabla::Var>);
+            runner.run("grad/reverse", params, [&] { do_not_optimize(reverse(x)); }, double(n));
+
+            std::function<nabla::Var(const nabla::VarVec&)> f = objective<nabla::Var>;
+            nabla::Gradient gradient;
+            runner.run("grad/reverse_into", params, [&] {
+                nabla::grad(f, x, gradient);
+                do_not_optimize(gradient);
+            }, double(n));
+        }
+    }
+} // namespace bench
@@ -0,0 +1,66 @@
+#include "bench.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Count every heap allocation of the process. Relaxed atomics: benchmarks only read the
+// counters between iterations of the calling thread.
+static std::atomic<uint64_t> g_allocation_count{0};
+static std::atomic<uint64_t> g_allocated_bytes{0};
+
+void* operator new(size_t size) {
+    g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+// Over-aligned allocations (e.g. tensor buffers), counted alike
+void* operator new(size_t size, std::align_val_t align) {
+    g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    size_t alignment = std::max(size_t(align), sizeof(void*));
+    if (void* p = std::aligned_alloc(alignment, (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t align) { return operator new(size, align); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace bench {
+    uint64_t allocation_count() { return g_allocation_count.load(std::memory_order_relaxed); }
+    uint64_t allocated_bytes() { return g_allocated_bytes.load(std::memory_order_relaxed); }
+} // namespace bench
+
+static void usage(const char* program) {
+    std::cerr << "usage: " << program << " [--filter <substring>] [--reps <n>] [--warmup <n>]" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    bench::Options options;
+    for (int i = 1; i < argc; ++i) {
+        if (i + 1 < argc && std::strcmp(argv[i], "--filter") == 0) options.filter = argv[++i];
+        else if (i + 1 < argc && std::strcmp(argv[i], "--reps") == 0) options.reps = std::max(1, std::atoi(argv[++i]));
+        else if (i + 1 < argc && std::strcmp(argv[i], "--warmup") == 0) options.warmup = std::atoi(argv[++i]);
+        else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    bench::Runner runner(options);
+    bench::gradient_benchmarks(runner);
+    bench::tape_benchmarks(runner);
+    bench::tensor_benchmarks(runner);
+    return EXIT_SUCCESS;
+}
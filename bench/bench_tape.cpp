@@ -0,0 +1,57 @@
+#include "bench.hpp"
+
+#include <string>
+
+#include <nablagrad/nabla.h>
+
+namespace bench {
+    // Record a chain of 4 * n operations over n leaves on the active tape, returning the outputs
+    // of the last 8 iterations
+    static std::vector<nabla::node_index_t> record(const std::vector<double>& x) {
+        std::vector<nabla::Var> leaves(x.begin(), x.end());
+        std::vector<nabla::node_index_t> outputs;
+        nabla::Var acc = leaves[0];
+        for (size_t i = 0; i < leaves.size(); ++i) {
+            acc = acc * leaves[i] + sin(leaves[i]) / leaves[(i + 1) % leaves.size()];
+            if (i + 8 >= leaves.size()) outputs.push_back(acc.node_gradtape_index);
+        }
+        return outputs;
+    }
+
+    // Throughput of recording on the gradient tape and of the different reverse sweeps
+    void tape_benchmarks(Runner& runner) {
+        for (size_t n : { 1000, 100000 }) {
+            std::string params = "n=" + std::to_string(n);
+            std::vector<double> x(n);
+            for (size_t i = 0; i < n; ++i) x[i] = 1. + 1e-4 * double(i);
+
+            nabla::GradientTape tape(8 * n);
+            nabla::GradientTapeScope scope(tape);
+
+            runner.run("tape/record", params, [&] {
+                nabla::GradientTape::mark_t mark = tape.mark();
+                do_not_optimize(record(x));
+                tape.rewind(mark);
+            }, double(5 * n));
+
+            std::vector<nabla::node_index_t> outputs = record(x);
+            double nodes = double(tape.size());
+            std::vector<double> adjoints;
+
+            runner.run("tape/backward", params, [&] {
+                tape.backward(outputs.back(), adjoints);
+                do_not_optimize(adjoints);
+            }, nodes);
+
+            runner.run("tape/backward_vector8", params, [&] {
+                tape.backward_vector(outputs, adjoints);
+                do_not_optimize(adjoints);
+            }, nodes);
+
+            runner.run("tape/backward_parallel", params, [&] {
+                tape.backward_parallel(outputs.back(), adjoints, 0, true);
+                do_not_optimize(adjoints);
+            }, nodes);
+        }
+    }
+} // namespace bench
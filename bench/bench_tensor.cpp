@@ -0,0 +1,102 @@
+#include "bench.hpp"
+
+#include <string>
+
+#include <nablagrad/tensor.hpp>
+#include <nablagrad/tensor_aops.hpp>
+#include <nablagrad/tensor_lazy.hpp>
+
+namespace bench {
+    // Elementwise tensor operators (with and without broadcasting) and transpose on square matrices of growing size, and a layout
+    // conversion
+    void tensor_benchmarks(Runner& runner) {
+        for (size_t n : { 64, 256, 1024 }) {
+            std::string params = "shape=" + std::to_string(n) + "x" + std::to_string(n);
+            nabla::Tensor a = nabla::Tensor::rand({n, n});
+            nabla::Tensor b = nabla::Tensor::rand({n, n});
+            nabla::Tensor bias = nabla::Tensor::rand({n});
+            double elements = double(n * n);
+
+            runner.run("tensor/add", params, [&] { do_not_optimize(nabla::add(a, b)); }, elements);
+            runner.run("tensor/add_bias", params, [&] { do_not_optimize(nabla::add(a, bias)); }, elements);
+            runner.run("tensor/mul", params, [&] { do_not_optimize(nabla::mul(a, b)); }, elements);
+            runner.run("tensor/exp", params, [&] { do_not_optimize(nabla::exp(a)); }, elements);
+            runner.run("tensor/sin", params, [&] { do_not_optimize(nabla::sin(a)); }, elements);
+            runner.run("tensor/tanh", params, [&] { do_not_optimize(nabla::tanh(a)); }, elements);
+            runner.run("tensor/transpose", params, [&] { do_not_optimize(a.t().contiguous()); }, elements);
+        }
+
+        // float32 tensors: half the bytes of the bandwidth-bound operators above
+        {
+            nabla::FloatTensor a = nabla::FloatTensor::rand({ 1024, 1024 });
+            nabla::FloatTensor b = nabla::FloatTensor::rand({ 1024, 1024 });
+            double elements = double(a.size());
+            runner.run("tensor/add_f32", "shape=1024x1024", [&] { do_not_optimize(nabla::add(a, b)); }, elements);
+            runner.run("tensor/exp_f32", "shape=1024x1024", [&] { do_not_optimize(nabla::exp(a)); }, elements);
+            runner.run("tensor/transpose_f32", "shape=1024x1024", [&] { do_not_optimize(a.t().contiguous()); }, elements);
+            runner.run("tensor/sum_f32", "shape=1024x1024", [&] { do_not_optimize(nabla::sum(a)); }, elements);
+            runner.run("tensor/matmul_f32", "shape=1024x1024", [&] { do_not_optimize(nabla::matmul(a, b)); },
+                       2. * 1024 * 1024 * 1024);
+        }
+
+        // Matrix products; items are flops
+        for (size_t n : { 64, 256, 1024 }) {
+            std::string params = "shape=" + std::to_string(n) + "x" + std::to_string(n);
+            nabla::Tensor a = nabla::Tensor::rand({n, n});
+            nabla::Tensor b = nabla::Tensor::rand({n, n});
+            double flops = 2. * double(n) * double(n) * double(n);
+            runner.run("tensor/matmul", params, [&] { do_not_optimize(nabla::matmul(a, b)); }, flops);
+            runner.run("tensor/matmul_tn", params, [&] { do_not_optimize(nabla::matmul(a.t(), b)); }, flops);
+        }
+        {
+            nabla::Tensor a = nabla::Tensor::rand({ 64, 32, 64 });
+            nabla::Tensor b = nabla::Tensor::rand({ 64, 64, 32 });
+            runner.run("tensor/matmul_batched", "shape=64x32x64", [&] { do_not_optimize(nabla::matmul(a, b)); },
+                       2. * 64 * 32 * 64 * 32);
+        }
+
+        // An elementwise chain, eager (one temporary per operator) and fused
+        {
+            nabla::Tensor x = nabla::Tensor::rand({ 1024, 1024 }), y = nabla::Tensor::rand({ 1024, 1024 });
+            nabla::Tensor z = nabla::Tensor::rand({ 1024, 1024 });
+            double elements = double(x.size());
+            runner.run("tensor/chain_eager", "shape=1024x1024", [&] {
+                do_not_optimize(nabla::add(nabla::mul(nabla::exp(nabla::sin(x)), y), z));
+            }, elements);
+            nabla::lazy::Expr lx = x, ly = y, lz = z;
+            nabla::lazy::Expr f = exp(sin(lx)) * ly + lz;
+            runner.run("tensor/chain_lazy", "shape=1024x1024", [&] { do_not_optimize(f.eval()); }, elements);
+            nabla::Tensor upstream = nabla::Tensor::ones({ 1024, 1024 });
+            runner.run("tensor/chain_lazy_backward", "shape=1024x1024",
+                       [&] { do_not_optimize(f.backward(upstream, { lx, ly, lz })); }, elements);
+        }
+
+        // Reductions over all elements, over rows (axis 1, contiguous) and over columns (axis 0)
+        {
+            nabla::Tensor a = nabla::Tensor::rand({ 1024, 1024 });
+            double elements = double(a.size());
+            runner.run("tensor/sum", "shape=1024x1024", [&] { do_not_optimize(nabla::sum(a)); }, elements);
+            runner.run("tensor/sum_axis1", "shape=1024x1024", [&] { do_not_optimize(nabla::sum(a, { 1 })); }, elements);
+            runner.run("tensor/sum_axis0", "shape=1024x1024", [&] { do_not_optimize(nabla::sum(a, { 0 })); }, elements);
+            runner.run("tensor/max_axis1", "shape=1024x1024", [&] { do_not_optimize(nabla::max(a, { 1 })); }, elements);
+            runner.run("tensor/logsumexp_axis1", "shape=1024x1024",
+                       [&] { do_not_optimize(nabla::logsumexp(a, { 1 })); }, elements);
+        }
+
+        // Small operators creating and freeing same-sized intermediates, with buffers from the
+        // system allocator and from the (default) caching allocator
+        {
+            nabla::Tensor x = nabla::Tensor::rand({ 64, 64 }), w = nabla::Tensor::rand({ 64, 64 });
+            auto step = [&] { do_not_optimize(nabla::tanh(nabla::sub(nabla::mul(x, w), x))); };
+            nabla::memory::set_allocator(nabla::memory::system_allocator());
+            runner.run("tensor/alloc_system", "shape=64x64", step, double(x.size()));
+            nabla::memory::set_allocator(nabla::memory::caching_allocator());
+            runner.run("tensor/alloc_caching", "shape=64x64", step, double(x.size()));
+        }
+
+        // NCHW -> NHWC layout conversion
+        nabla::Tensor nchw = nabla::Tensor::rand({ 8, 64, 56, 56 });
+        runner.run("tensor/permute_nchw_nhwc", "shape=8x64x56x56",
+                   [&] { do_not_optimize(nchw.permute({ 0, 2, 3, 1 }).contiguous()); }, double(nchw.size()));
+    }
+} // namespace bench
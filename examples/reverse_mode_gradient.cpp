@@ -12,7 +12,7 @@ template<typename T> T f(const std::vector<T>& x) {
 
 int main() {
     std::vector<double> x = {2.0, 5.0}; // vector at which the gradient is evaluated
-    auto grad_f = nabla::grad(f<nabla::Tensor>);
+    auto grad_f = nabla::grad(f<nabla::Var>);
 
     std::cout << "x = " << x << std::endl;
     std::cout << "f(x) = " << f<double>(x) << std::endl;
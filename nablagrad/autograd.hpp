@@ -1,76 +1,315 @@
 #ifndef AUTOGRAD_H
 #define AUTOGRAD_H
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "tensor.hpp"
 
 namespace nabla {
     namespace ta_ops {
+        // Operators are templated on the element type `T` of their tensors
+        template<typename T>
         struct TensorOperator {
             std::string name;
             // need to override this
-            Tensor forward() { return Tensor({4}); }
-            Tensor backward() { return Tensor({4}); }
+            BasicTensor<T> forward() { return BasicTensor<T>({4}); }
+            BasicTensor<T> backward() { return BasicTensor<T>({4}); }
         };
-        struct TensorAdd : public TensorOperator {
-            TensorAdd(const Tensor& input0, const Tensor& input1) {
-                std::shared_ptr<Tensor> input_0 = std::make_shared<Tensor>(input0);
-                std::shared_ptr<Tensor> input_1 = std::make_shared<Tensor>(input1);
-                inputs_.push_back(input_0);
-                inputs_.push_back(input_1);
+        // Binary elementwise operators with broadcasting: `backward()` returns the gradients of
+        // both inputs given the gradient of the output, summed back to the input shapes
+        template<typename T>
+        struct TensorAdd : public TensorOperator<T> {
+            TensorAdd(const BasicTensor<T>& input0, const BasicTensor<T>& input1) {
+                inputs_.push_back(std::make_shared<BasicTensor<T>>(input0));
+                inputs_.push_back(std::make_shared<BasicTensor<T>>(input1));
 
-                name = "tensor_add_0";
+                this->name = "tensor_add_0";
             }
 
-            Tensor forward() {
-                Tensor add_tensor(inputs_[0]->shape(), inputs_[0]->requires_grad() || inputs_[1]->requires_grad(), true);
-                std::vector<double> res(inputs_[0]->raw_data());
-                std::transform(res.begin(), res.end(), inputs_[1]->raw_data().begin(), res.begin(), std::plus<double>());
-                add_tensor.setdata(res);
-                return add_tensor;
+            BasicTensor<T> forward() {
+                return map_binary(*inputs_[0], *inputs_[1], std::plus<T>(), true);
             }
 
-            Tensor backward() {
-                return Tensor::ones({2, inputs_[0]->size()});
+            std::pair<BasicTensor<T>, BasicTensor<T>> backward(const BasicTensor<T>& upstream) const {
+                return { sum_to_shape(upstream, inputs_[0]->shape()), sum_to_shape(upstream, inputs_[1]->shape()) };
             }
 
-            const std::vector<std::shared_ptr<Tensor>> inputs() const { return inputs_; }
+            const std::vector<std::shared_ptr<BasicTensor<T>>> inputs() const { return inputs_; }
 
-            std::vector<std::shared_ptr<Tensor>> inputs_;
+            std::vector<std::shared_ptr<BasicTensor<T>>> inputs_;
+        };
+
+        template<typename T>
+        struct TensorSub : public TensorOperator<T> {
+            TensorSub(const BasicTensor<T>& input0, const BasicTensor<T>& input1) {
+                inputs_.push_back(std::make_shared<BasicTensor<T>>(input0));
+                inputs_.push_back(std::make_shared<BasicTensor<T>>(input1));
+
+                this->name = "tensor_sub_0";
+            }
+
+            BasicTensor<T> forward() {
+                return map_binary(*inputs_[0], *inputs_[1], std::minus<T>(), true);
+            }
+
+            std::pair<BasicTensor<T>, BasicTensor<T>> backward(const BasicTensor<T>& upstream) const {
+                BasicTensor<T> neg = upstream.apply_transform([](T g) { return -g; });
+                return { sum_to_shape(upstream, inputs_[0]->shape()), sum_to_shape(neg, inputs_[1]->shape()) };
+            }
+
+            const std::vector<std::shared_ptr<BasicTensor<T>>> inputs() const { return inputs_; }
+
+            std::vector<std::shared_ptr<BasicTensor<T>>> inputs_;
+        };
+
+        template<typename T>
+        struct TensorMul : public TensorOperator<T> {
+            TensorMul(const BasicTensor<T>& input0, const BasicTensor<T>& input1) {
+                inputs_.push_back(std::make_shared<BasicTensor<T>>(input0));
+                inputs_.push_back(std::make_shared<BasicTensor<T>>(input1));
+
+                this->name = "tensor_mul_0";
+            }
+
+            BasicTensor<T> forward() {
+                return map_binary(*inputs_[0], *inputs_[1], std::multiplies<T>(), true);
+            }
+
+            std::pair<BasicTensor<T>, BasicTensor<T>> backward(const BasicTensor<T>& upstream) const {
+                const BasicTensor<T>& a = *inputs_[0];
+                const BasicTensor<T>& b = *inputs_[1];
+                return { sum_to_shape(map_binary(upstream, b, std::multiplies<T>(), true), a.shape()),
+                         sum_to_shape(map_binary(upstream, a, std::multiplies<T>(), true), b.shape()) };
+            }
+
+            const std::vector<std::shared_ptr<BasicTensor<T>>> inputs() const { return inputs_; }
+
+            std::vector<std::shared_ptr<BasicTensor<T>>> inputs_;
+        };
+
+        template<typename T>
+        struct TensorDiv : public TensorOperator<T> {
+            TensorDiv(const BasicTensor<T>& input0, const BasicTensor<T>& input1) {
+                inputs_.push_back(std::make_shared<BasicTensor<T>>(input0));
+                inputs_.push_back(std::make_shared<BasicTensor<T>>(input1));
+
+                this->name = "tensor_div_0";
+            }
+
+            BasicTensor<T> forward() {
+                return map_binary(*inputs_[0], *inputs_[1], std::divides<T>(), true);
+            }
+
+            // d(a/b)/da = 1/b, d(a/b)/db = -(a/b)/b
+            std::pair<BasicTensor<T>, BasicTensor<T>> backward(const BasicTensor<T>& upstream) const {
+                const BasicTensor<T>& a = *inputs_[0];
+                const BasicTensor<T>& b = *inputs_[1];
+                BasicTensor<T> grad_a = map_binary(upstream, b, std::divides<T>(), true);
+                BasicTensor<T> quotient = map_binary(a, b, std::divides<T>(), true);
+                BasicTensor<T> grad_b = map_binary(grad_a, quotient, [](T g, T q) { return -g * q; }, true);
+                return { sum_to_shape(grad_a, a.shape()), sum_to_shape(grad_b, b.shape()) };
+            }
+
+            const std::vector<std::shared_ptr<BasicTensor<T>>> inputs() const { return inputs_; }
+
+            std::vector<std::shared_ptr<BasicTensor<T>>> inputs_;
+        };
+
+        template<typename T>
+        struct TensorMatMul : public TensorOperator<T> {
+            TensorMatMul(const BasicTensor<T>& input0, const BasicTensor<T>& input1) {
+                inputs_.push_back(std::make_shared<BasicTensor<T>>(input0));
+                inputs_.push_back(std::make_shared<BasicTensor<T>>(input1));
+
+                this->name = "tensor_matmul_0";
+            }
+
+            BasicTensor<T> forward() {
+                return batched_matmul(*inputs_[0], *inputs_[1], true);
+            }
+
+            // Gradients of both inputs given the gradient of the output, computed with the same
+            // GEMM kernel on transposed operands
+            std::pair<BasicTensor<T>, BasicTensor<T>> backward(const BasicTensor<T>& upstream) const {
+                return batched_matmul_backward(upstream, *inputs_[0], *inputs_[1]);
+            }
+
+            const std::vector<std::shared_ptr<BasicTensor<T>>> inputs() const { return inputs_; }
+
+            std::vector<std::shared_ptr<BasicTensor<T>>> inputs_;
+        };
+
+        // Reductions of one input over `axes` (all dimensions when empty), dropping the reduced
+        // dimensions unless `keepdim` (see `reduce()`). `backward()` returns the gradient of the
+        // input given the gradient of the reduced output, broadcast back to the input shape.
+        template<typename T>
+        struct TensorReduce : public TensorOperator<T> {
+            TensorReduce(const BasicTensor<T>& input, const std::vector<size_t>& axes, bool keepdim, const std::string& name)
+                : axes_{axes}, keepdim_{keepdim} {
+                inputs_.push_back(std::make_shared<BasicTensor<T>>(input));
+
+                this->name = name;
+            }
+
+            const std::vector<std::shared_ptr<BasicTensor<T>>> inputs() const { return inputs_; }
+
+            std::vector<std::shared_ptr<BasicTensor<T>>> inputs_;
+            std::vector<size_t> axes_;
+            bool keepdim_;
+
+        protected:
+            // `upstream` with the reduced dimensions of the input restored as size-1 dimensions
+            BasicTensor<T> upstream_keepdim_(const BasicTensor<T>& upstream) const {
+                return upstream.reshape(reduced_shape(inputs_[0]->shape(), axes_, true));
+            }
+        };
+
+        template<typename T>
+        struct TensorSum : public TensorReduce<T> {
+            TensorSum(const BasicTensor<T>& input, const std::vector<size_t>& axes, bool keepdim)
+                : TensorReduce<T>(input, axes, keepdim, "tensor_sum_0") {}
+
+            BasicTensor<T> forward() {
+                return reduce(*this->inputs_[0], kernels::ReduceOp::sum, this->axes_, this->keepdim_, true);
+            }
+
+            BasicTensor<T> backward(const BasicTensor<T>& upstream) const {
+                return this->upstream_keepdim_(upstream).broadcast_to(this->inputs_[0]->shape()).contiguous();
+            }
+        };
+
+        template<typename T>
+        struct TensorMean : public TensorReduce<T> {
+            TensorMean(const BasicTensor<T>& input, const std::vector<size_t>& axes, bool keepdim)
+                : TensorReduce<T>(input, axes, keepdim, "tensor_mean_0") {}
+
+            BasicTensor<T> forward() {
+                BasicTensor<T> s = reduce(*this->inputs_[0], kernels::ReduceOp::sum, this->axes_, this->keepdim_, true);
+                if (s.size() == 0) return s;
+                T count = T(this->inputs_[0]->size()) / T(s.size());
+                return s.apply_transform([count](T x) { return x / count; });
+            }
+
+            BasicTensor<T> backward(const BasicTensor<T>& upstream) const {
+                T count = T(this->inputs_[0]->size()) / T(std::max<size_t>(1, upstream.size()));
+                BasicTensor<T> grad = this->upstream_keepdim_(upstream).broadcast_to(this->inputs_[0]->shape());
+                return grad.apply_transform([count](T g) { return g / count; });
+            }
+        };
+
+        // NaN propagates: the maximum of elements including a NaN is NaN. The gradient is split
+        // evenly between the elements equal to the maximum.
+        template<typename T>
+        struct TensorMax : public TensorReduce<T> {
+            TensorMax(const BasicTensor<T>& input, const std::vector<size_t>& axes, bool keepdim)
+                : TensorReduce<T>(input, axes, keepdim, "tensor_max_0") {}
+
+            BasicTensor<T> forward() {
+                return reduce(*this->inputs_[0], kernels::ReduceOp::max, this->axes_, this->keepdim_, true);
+            }
+
+            BasicTensor<T> backward(const BasicTensor<T>& upstream) const {
+                const BasicTensor<T>& a = *this->inputs_[0];
+                BasicTensor<T> m = reduce(a, kernels::ReduceOp::max, this->axes_, true, true);
+                BasicTensor<T> is_max = map_binary(a, m, [](T x, T mx) { return x == mx ? T(1) : T(0); }, true);
+                BasicTensor<T> ties = reduce(is_max, kernels::ReduceOp::sum, this->axes_, true, true);
+                BasicTensor<T> share = map_binary(this->upstream_keepdim_(upstream), ties, std::divides<T>(), true);
+                return map_binary(is_max, share, std::multiplies<T>(), true);
+            }
+        };
+
+        // log(sum(exp(x))), computed as m + log(sum(exp(x - m))) with m the maximum so that exp
+        // cannot overflow. Its gradient is the softmax of the input.
+        template<typename T>
+        struct TensorLogSumExp : public TensorReduce<T> {
+            TensorLogSumExp(const BasicTensor<T>& input, const std::vector<size_t>& axes, bool keepdim)
+                : TensorReduce<T>(input, axes, keepdim, "tensor_logsumexp_0") {}
+
+            BasicTensor<T> forward() {
+                return logsumexp_(this->keepdim_);
+            }
+
+            BasicTensor<T> backward(const BasicTensor<T>& upstream) const {
+                BasicTensor<T> shifted = map_binary(*this->inputs_[0], logsumexp_(true), std::minus<T>(), true);
+                BasicTensor<T> softmax = map_unary(shifted, kernels::UnaryFn::exp, true);
+                return map_binary(softmax, this->upstream_keepdim_(upstream), std::multiplies<T>(), true);
+            }
+
+        private:
+            BasicTensor<T> logsumexp_(bool keepdim) const {
+                const BasicTensor<T>& a = *this->inputs_[0];
+                // infinite maxima are not subtracted: all -inf gives -inf, any +inf gives +inf
+                BasicTensor<T> m = reduce(a, kernels::ReduceOp::max, this->axes_, true, true)
+                    .apply_transform([](T x) { return std::isfinite(x) ? x : T(0); });
+                BasicTensor<T> e = map_unary(map_binary(a, m, std::minus<T>(), true), kernels::UnaryFn::exp, true);
+                BasicTensor<T> s = map_unary(reduce(e, kernels::ReduceOp::sum, this->axes_, keepdim, true), kernels::UnaryFn::log, true);
+                return map_binary(s, m.reshape(s.shape()), std::plus<T>(), true);
+            }
+        };
+
+        // Euclidean (Frobenius) norm; d|x|/dx = x / |x|, taken as 0 where the norm is 0
+        template<typename T>
+        struct TensorNorm : public TensorReduce<T> {
+            TensorNorm(const BasicTensor<T>& input, const std::vector<size_t>& axes, bool keepdim)
+                : TensorReduce<T>(input, axes, keepdim, "tensor_norm_0") {}
+
+            BasicTensor<T> forward() {
+                return norm_(this->keepdim_);
+            }
+
+            BasicTensor<T> backward(const BasicTensor<T>& upstream) const {
+                BasicTensor<T> scale = map_binary(this->upstream_keepdim_(upstream), norm_(true),
+                                                  [](T g, T n) { return n == 0 ? T(0) : g / n; }, true);
+                return map_binary(*this->inputs_[0], scale, std::multiplies<T>(), true);
+            }
+
+        private:
+            BasicTensor<T> norm_(bool keepdim) const {
+                return reduce(*this->inputs_[0], kernels::ReduceOp::sum_squares, this->axes_, keepdim, true)
+                    .apply_transform([](T x) { return std::sqrt(x); });
+            }
         };
     } // namespace ta_ops
 
     namespace autograd {
-        struct ComputationGraph;
+        template<typename T>
         struct ComputationNode {
             ComputationNode() {}
-            ComputationNode(const Tensor& leaf) : tensor{std::make_shared<Tensor>(leaf)}, is_leaf{tensor->is_leaf_} {}
-            ComputationNode(const ta_ops::TensorOperator& t_op) : tensor_op{t_op} {}
+            ComputationNode(const BasicTensor<T>& leaf) : tensor{std::make_shared<BasicTensor<T>>(leaf)}, is_leaf{tensor->is_leaf_} {}
+            ComputationNode(const ta_ops::TensorOperator<T>& t_op) : tensor_op{t_op} {}
 
-            std::shared_ptr<Tensor> tensor;
+            std::shared_ptr<BasicTensor<T>> tensor;
             bool is_leaf = false;
-            ta_ops::TensorOperator tensor_op;
+            ta_ops::TensorOperator<T> tensor_op;
         };
 
         // A ComputationGraph keep tracks of the operators applied to every tensor requiring
         // gradient computation (i.e. a tensor instantiated with the requires_grad flag)
         // This graph is just a list of 'ComputationNode' objects, which store the actual
         // tensor operator. Leaf nodes, however, are not associated with a tensor operator, but
-        // with a leaf tensor (i.e. a tensor with no inputs)
+        // with a leaf tensor (i.e. a tensor with no inputs). Tensors of each element type `T` are
+        // recorded on their own graph.
+        template<typename T>
         struct ComputationGraph {
             ComputationGraph(const ComputationGraph&) = delete;
 
             // Public API of the computation graph. Just calls to the actual internal methods
             static size_t size() { return _instance().size_(); }
-            static void push_leaf(Tensor& tensor) { _instance().push_leaf_(tensor); }
-            static void push_operator(const ta_ops::TensorOperator& op, Tensor& out) { _instance().push_operator_(op, out); }
-            static const ComputationNode& get_operator(size_t op_index) {
+            static void push_leaf(BasicTensor<T>& tensor) { _instance().push_leaf_(tensor); }
+            static void push_operator(const ta_ops::TensorOperator<T>& op, BasicTensor<T>& out) { _instance().push_operator_(op, out); }
+            static const ComputationNode<T>& get_operator(size_t op_index) {
                 return _instance().get_operator_(op_index);
             }
 
+            // Each thread records on its own graph
             static ComputationGraph& _instance() {
-                static ComputationGraph cg_instance_;
+                thread_local ComputationGraph cg_instance_;
                 return cg_instance_;
             }
 
@@ -79,30 +318,25 @@ namespace nabla {
 
             // Push a leaf tensor into the computational graph. Leaf tensors are retained in the
             // graph after gradient backward propagation
-            void push_leaf_(Tensor& tensor) {
+            void push_leaf_(BasicTensor<T>& tensor) {
                 tensor.cg_node_idx_ = computation_list_.size();
                 tensor.is_leaf_ = true;
-                ComputationNode tensor_node(tensor);
+                ComputationNode<T> tensor_node(tensor);
                 computation_list_.emplace_back(tensor_node);
-
-                std::cout << "[DEBUG] [nabla::autograd::ComputationGraph::push_leaf] Pushed leaf: "
-                    << tensor.name() << std::endl;
             }
 
-            void push_operator_(const ta_ops::TensorOperator& op, Tensor& out) {
+            void push_operator_(const ta_ops::TensorOperator<T>& op, BasicTensor<T>& out) {
                 out.cg_node_idx_ = computation_list_.size();
-                ComputationNode node_op(op);
+                ComputationNode<T> node_op(op);
                 computation_list_.emplace_back(node_op);
-                std::cout << "[DEBUG] [nabla::autograd::ComputationGraph::push_operator] Pushed operator: "
-                   << op.name << std::endl;
             }
 
-            const ComputationNode& get_operator_(size_t op_index) const {
+            const ComputationNode<T>& get_operator_(size_t op_index) const {
                 return computation_list_[op_index];
             }
 
             ComputationGraph() {}
-            std::vector<ComputationNode> computation_list_{};
+            std::vector<ComputationNode<T>> computation_list_{};
         };
     } // namespace autograd
 } // namespace nabla
@@ -0,0 +1,169 @@
+#include "checkpointing.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace nabla {
+    namespace {
+        using StepFn = std::function<std::vector<Var>(const std::vector<Var>&)>;
+
+        // min(binomial(s + r, s), limit): number of steps reversible with s snapshots and r
+        // recomputations, computed as binomial(s + r, min(s, r)) and stopped once it reaches `limit`
+        size_t reversible_steps_(size_t s, size_t r, size_t limit) {
+            size_t k = std::min(s, r), n = s + r;
+            size_t beta = 1;
+            for (size_t i = 1; i <= k && beta < limit; ++i) beta = beta * (n - k + i) / i; // exact: beta = binomial(n - k + i, i)
+            return std::min(beta, limit);
+        }
+
+        struct Checkpointer {
+            Checkpointer(const StepFn& step, GradientTape& tape, CheckpointStats& stats, GradientTape::mark_t base)
+                : step{step}, tape{tape}, stats{stats}, base{base} {}
+
+            const StepFn& step;
+            GradientTape& tape;
+            CheckpointStats& stats;
+            GradientTape::mark_t base; // tape position before the sweep
+            std::vector<double> tape_adjoints;
+
+            std::vector<double> primals_(const std::vector<Var>& v) {
+                std::vector<double> p(v.size());
+                for (size_t i = 0; i < v.size(); ++i) p[i] = v[i].get_primal();
+                return p;
+            }
+
+            // Advance `x` by `count` steps without keeping the recording
+            std::vector<double> advance(std::vector<double> x, size_t count) {
+                for (size_t k = 0; k < count; ++k) {
+                    GradientTape::mark_t mark = this->tape.mark();
+                    x = this->primals_(this->step(std::vector<Var>(x.begin(), x.end())));
+                    this->tape.rewind(mark);
+                    ++this->stats.forward_steps;
+                }
+                return x;
+            }
+
+            // Given the adjoint of x_{k+1}, compute the adjoint of x_k (one recorded step)
+            void reverse_step(const std::vector<double>& xk, std::vector<double>& adjoint) {
+                GradientTape::mark_t mark = this->tape.mark();
+                std::vector<Var> input(xk.begin(), xk.end());
+                std::vector<Var> output = this->step(input);
+                ++this->stats.forward_steps;
+                ++this->stats.recorded_steps;
+                this->stats.peak_tape_nodes = std::max(this->stats.peak_tape_nodes, this->tape.size() - this->base);
+
+                std::vector<node_index_t> outputs(output.size());
+                for (size_t i = 0; i < output.size(); ++i) outputs[i] = output[i].node_gradtape_index;
+                this->tape.backward(outputs, adjoint, this->tape_adjoints);
+
+                adjoint.resize(input.size());
+                for (size_t i = 0; i < input.size(); ++i) adjoint[i] = this->tape_adjoints[input[i].node_gradtape_index];
+                this->tape.rewind(mark);
+            }
+
+            // Pending part of the reverse sweep: reverse steps [a, b) starting from the snapshot
+            // x_a, with `snapshots` free snapshot slots
+            struct Range {
+                size_t a, b, snapshots;
+                std::vector<double> xa;
+            };
+            // Ranges still to reverse, the last one first. Every range holds one snapshot, so the
+            // stack never holds more than the snapshot budget plus x_0.
+            std::vector<Range> pending;
+
+            // Split the last pending range until it can be reversed directly (a single step, or
+            // no free snapshot left), storing a snapshot at every split. The first call is the
+            // forward sweep towards x_N.
+            void split() {
+                while (true) {
+                    Range& range = this->pending.back();
+                    size_t l = range.b - range.a;
+                    if (l == 1 || range.snapshots == 0) return;
+
+                    // smallest number of recomputations r reversing l steps with the given snapshots,
+                    // then split so that the right part [m, b) needs at most r recomputations with
+                    // one snapshot less and the left part [a, m) at most r - 1 with the same snapshots
+                    size_t r = 1;
+                    while (reversible_steps_(range.snapshots, r, l) < l) ++r;
+                    size_t right = std::min(l - 1, reversible_steps_(range.snapshots - 1, r, l));
+                    size_t m = range.b - right;
+
+                    Range next{m, range.b, range.snapshots - 1, this->advance(range.xa, m - range.a)};
+                    range.b = m;
+                    this->pending.push_back(std::move(next));
+                    this->stats.peak_snapshots = std::max(this->stats.peak_snapshots, this->pending.size());
+                }
+            }
+
+            // Reverse the last pending range, already split; `adjoint` holds the adjoint of x_b on
+            // entry and the adjoint of x_a on exit
+            void reverse_last(std::vector<double>& adjoint) {
+                Range range = std::move(this->pending.back());
+                this->pending.pop_back();
+                if (range.b - range.a == 1) {
+                    this->reverse_step(range.xa, adjoint);
+                    return;
+                }
+                // no free slots: recompute every state from x_a
+                for (size_t k = range.b; k > range.a; --k) this->reverse_step(this->advance(range.xa, k - 1 - range.a), adjoint);
+            }
+        };
+    } // namespace
+
+    CheckpointResult checkpointed_gradient(
+        std::function<std::vector<Var>(const std::vector<Var>&)> step,
+        std::function<Var(const std::vector<Var>&)> loss,
+        const std::vector<double>& x0,
+        size_t steps,
+        size_t snapshots
+    ) {
+        GradientTape& tape = GradientTape::instance();
+        GradientTape::mark_t mark = tape.mark();
+
+        CheckpointResult result;
+        CheckpointStats& stats = result.stats;
+        stats.steps = steps;
+        stats.snapshot_budget = snapshots;
+        stats.peak_snapshots = 1;
+
+        Checkpointer checkpointer{step, tape, stats, mark};
+
+        // nodes recorded by a single step, to estimate the size of a full recording
+        {
+            std::vector<Var> input(x0.begin(), x0.end());
+            GradientTape::mark_t step_mark = tape.mark();
+            step(input);
+            stats.full_tape_nodes = (tape.size() - step_mark) * steps + x0.size();
+            tape.rewind(mark);
+        }
+
+        // forward sweep to the final state, storing the snapshots of the first ranges to reverse
+        // on the way, then seed the reverse sweep with the loss gradient
+        std::vector<double> xn = x0;
+        if (steps > 0) {
+            checkpointer.pending.push_back({0, steps, std::min(snapshots, steps - 1), x0});
+            checkpointer.split();
+            const auto& last = checkpointer.pending.back();
+            xn = checkpointer.advance(last.xa, steps - last.a);
+        }
+        std::vector<Var> final_state(xn.begin(), xn.end());
+        Var y = loss(final_state);
+        result.value = y.get_primal();
+
+        std::vector<double> loss_adjoints;
+        tape.backward(y.node_gradtape_index, loss_adjoints);
+        std::vector<double> adjoint(final_state.size());
+        for (size_t i = 0; i < final_state.size(); ++i) adjoint[i] = loss_adjoints[final_state[i].node_gradtape_index];
+        stats.peak_tape_nodes = tape.size() - mark;
+        tape.rewind(mark);
+
+        while (!checkpointer.pending.empty()) {
+            checkpointer.split();
+            checkpointer.reverse_last(adjoint);
+        }
+        result.gradient = adjoint;
+        tape.rewind(mark);
+        return result;
+    }
+} // namespace nabla
@@ -0,0 +1,58 @@
+#ifndef CHECKPOINTING_H
+#define CHECKPOINTING_H
+
+#include <iostream>
+#include <functional>
+#include <vector>
+
+#include "var.hpp"
+
+namespace nabla {
+    // Recomputation and memory figures of a checkpointed reverse sweep.
+    struct CheckpointStats {
+        size_t steps = 0;              // time steps of the simulation
+        size_t snapshot_budget = 0;    // snapshots allowed by the caller
+        size_t peak_snapshots = 0;     // snapshots held at the same time (including the initial state)
+        size_t forward_steps = 0;      // step evaluations, including recomputation
+        size_t recorded_steps = 0;     // step evaluations recorded on the gradient tape (= steps)
+        size_t peak_tape_nodes = 0;    // largest gradient tape held during the sweep
+        size_t full_tape_nodes = 0;    // estimated tape size of recording all the steps at once
+
+        // Step evaluations per time step (1 + recomputation overhead)
+        double recomputation_ratio() const { return steps ? double(forward_steps) / steps : 0.; }
+        // States that did not need to be stored, compared to keeping every intermediate state
+        size_t snapshots_saved() const { return steps + 1 - peak_snapshots; }
+
+        friend std::ostream& operator<<(std::ostream& os, const CheckpointStats& cs) {
+            os << "nabla::CheckpointStats[steps: " << cs.steps << ", snapshot_budget: " << cs.snapshot_budget
+               << ", peak_snapshots: " << cs.peak_snapshots << ", forward_steps: " << cs.forward_steps
+               << ", recomputation_ratio: " << cs.recomputation_ratio()
+               << ", peak_tape_nodes: " << cs.peak_tape_nodes << ", full_tape_nodes: " << cs.full_tape_nodes << "]";
+            return os;
+        }
+    };
+
+    struct CheckpointResult {
+        double value;
+        Gradient gradient;
+        CheckpointStats stats;
+    };
+
+    // Gradient of loss(x_N) wrt x_0 for the time-stepping simulation x_{k+1} = step(x_k),
+    // k = 0..steps-1, using binomial checkpointing (Griewank & Walther's revolve schedule).
+    // At most `snapshots` intermediate states are stored besides x_0, and only a single step is
+    // recorded on the gradient tape at a time; intermediate states are recomputed from the
+    // closest snapshot during the reverse sweep. With s snapshots and r recomputations per step,
+    // up to binomial(s + r, s) steps can be reversed; more than `steps - 1` snapshots are never
+    // useful. The first snapshots are stored by the forward sweep to x_N, and the schedule keeps
+    // its pending ranges on an explicit stack, so large budgets do not deepen the call stack.
+    // Uses the active gradient tape, which is rewound to its initial position before returning.
+    CheckpointResult checkpointed_gradient(
+        std::function<std::vector<Var>(const std::vector<Var>&)> step,
+        std::function<Var(const std::vector<Var>&)> loss,
+        const std::vector<double>& x0,
+        size_t steps,
+        size_t snapshots);
+} // namespace nabla
+
+#endif
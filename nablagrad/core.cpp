@@ -1,20 +1,46 @@
 #include "core.hpp"
+#include "parallel.hpp"
 #include <algorithm>
 
 namespace nabla {
+    namespace {
+        // Buffers of the reverse-mode gradient, kept per thread so that computing a gradient of
+        // the same size again allocates nothing
+        struct GradBuffers {
+            VarVec inputs;
+            Gradient adjoints;
+            bool in_use = false; // set while `f` runs, so that nested calls use their own buffers
+        };
+    } // namespace
+
     // reverse-mode gradient computation
-    std::function<Gradient(const RealVec&)> grad(std::function<Tensor(const TensorVec&)> f) {
-        auto Df = [f](const RealVec& x) -> Gradient {
-            TensorVec input_tensor(x.begin(), x.end());
-            Gradient full_gradient = f(input_tensor).backward();
+    void grad(const std::function<Var(const VarVec&)>& f, const RealVec& x, Gradient& gradient) {
+        thread_local GradBuffers thread_buffers;
+        GradBuffers nested_buffers;
+        GradBuffers& buffers = thread_buffers.in_use ? nested_buffers : thread_buffers;
+        struct InUse {
+            explicit InUse(bool& flag) : flag{flag} { flag = true; }
+            ~InUse() { flag = false; }
+            bool& flag;
+        } in_use(buffers.in_use);
 
-            size_t n = x.size();
-            Gradient grad_vec(n);
-            for (size_t i = 0; i < n; ++i) {
-                node_index_t tensor_index = input_tensor.at(i).node_gradtape_index;
-                grad_vec.at(i) = full_gradient.at(tensor_index);
-            }
-            return grad_vec;
+        GradientTape& tape = GradientTape::instance();
+        GradientTapeRewind rewind(tape); // the recording is dropped once swept
+
+        buffers.inputs.clear();
+        for (double xi : x) buffers.inputs.emplace_back(xi);
+        tape.backward(f(buffers.inputs).node_gradtape_index, buffers.adjoints);
+
+        size_t n = x.size();
+        gradient.resize(n);
+        for (size_t i = 0; i < n; ++i) gradient[i] = buffers.adjoints[buffers.inputs[i].node_gradtape_index];
+    }
+
+    std::function<Gradient(const RealVec&)> grad(std::function<Var(const VarVec&)> f) {
+        auto Df = [f](const RealVec& x) -> Gradient {
+            Gradient gradient;
+            grad(f, x, gradient);
+            return gradient;
         };
         return Df;
     }
@@ -41,6 +67,140 @@ namespace nabla {
         return Df;
     }
 
+    // gradient computation using forward-mode, parallelized over chunks of input variables
+    std::function<RealVec(const RealVec&)> grad_forward_parallel(
+        std::function<Dual(const DualVec&)> F, size_t num_threads, size_t chunk_size
+    ) {
+        auto Df = [F, num_threads, chunk_size](const RealVec& x) -> RealVec {
+            size_t n = x.size();
+            RealVec gradient(n);
+
+            parallel::for_chunks(n, num_threads, chunk_size, [&](size_t, size_t begin, size_t end) {
+                DualVec dual(x.begin(), x.end()); // per-chunk copy, never shared between threads
+                for (size_t i = begin; i < end; ++i) {
+                    dual[i].set_adjoint(1.);
+                    gradient[i] = F(dual).get_adjoint();
+                    dual[i].set_adjoint(0.);
+                }
+            });
+            return gradient;
+        };
+        return Df;
+    }
+
+    // jacobian computation using forward-mode, parallelized over chunks of columns
+    std::function<Jacobian(const RealVec&)> jacobian_forward_parallel(
+        std::function<DualVec(const DualVec&)> F, size_t num_threads, size_t chunk_size
+    ) {
+        auto Jf = [F, num_threads, chunk_size](const RealVec& x) -> Jacobian {
+            size_t n = x.size();
+            size_t m = F(DualVec(x.begin(), x.end())).size(); // output dimension
+            Jacobian jacobian(m, RealVec(n));
+
+            parallel::for_chunks(n, num_threads, chunk_size, [&](size_t, size_t begin, size_t end) {
+                DualVec dual(x.begin(), x.end());
+                for (size_t j = begin; j < end; ++j) {
+                    dual[j].set_adjoint(1.);
+                    DualVec y = F(dual);
+                    for (size_t i = 0; i < m; ++i) jacobian[i][j] = y.at(i).get_adjoint();
+                    dual[j].set_adjoint(0.);
+                }
+            });
+            return jacobian;
+        };
+        return Jf;
+    }
+
+    // hessian computation using hyper-dual numbers
+    std::function<Hessian(const RealVec&)> hessian_forward(std::function<HyperDual(const HyperDualVec&)> F) {
+        auto Hf = [F](const RealVec& x) -> Hessian {
+            size_t n = x.size();
+            HyperDualVec hdual(x.begin(), x.end());
+            Hessian hessian(n, RealVec(n));
+
+            for (size_t i = 0; i < n; ++i) {
+                hdual[i].set_adjoint1(1.);
+                for (size_t j = i; j < n; ++j) {
+                    hdual[j].set_adjoint2(1.);
+                    hessian[i][j] = hessian[j][i] = F(hdual).get_adjoint12();
+                    hdual[j].set_adjoint2(0.);
+                }
+                hdual[i].set_adjoint1(0.);
+            }
+            return hessian;
+        };
+        return Hf;
+    }
+
+    // hessian-vector product computation using hyper-dual numbers
+    std::function<RealVec(const RealVec&, const RealVec&)> hvp_forward(std::function<HyperDual(const HyperDualVec&)> F) {
+        auto Hv = [F](const RealVec& x, const RealVec& v) -> RealVec {
+            size_t n = x.size(); // x and v should have the same size!
+            HyperDualVec hdual(n);
+            for (size_t i = 0; i < n; ++i) hdual[i] = HyperDual(x[i], v[i], 0.);
+
+            RealVec hvp(n);
+            for (size_t i = 0; i < n; ++i) {
+                hdual[i].set_adjoint2(1.);
+                hvp[i] = F(hdual).get_adjoint12(); // e_i^T H v
+                hdual[i].set_adjoint2(0.);
+            }
+            return hvp;
+        };
+        return Hv;
+    }
+
+    JacobianMode select_jacobian_mode(size_t inputs, size_t outputs) {
+        JacobianMode jm;
+        jm.inputs = inputs;
+        jm.outputs = outputs;
+        jm.forward_cost = inputs;
+        jm.reverse_cost = 1 + outputs;
+        jm.mode = inputs <= outputs ? ADMode::forward : ADMode::reverse;
+        return jm;
+    }
+
+    // jacobian computation with automatic forward/reverse-mode selection
+    std::function<Jacobian(const RealVec&)> jacobian(
+        std::function<DualVec(const DualVec&)> F,
+        std::function<VarVec(const VarVec&)> G,
+        std::function<void(const JacobianMode&)> on_select
+    ) {
+        auto Jf = [F, G, on_select](const RealVec& x) -> Jacobian {
+            size_t n = x.size();
+            DualVec dual(x.begin(), x.end());
+            size_t m = F(dual).size(); // output dimension
+
+            JacobianMode jm = select_jacobian_mode(n, m);
+            if (on_select) on_select(jm);
+
+            Jacobian jacobian(m, RealVec(n));
+            if (jm.mode == ADMode::forward) {
+                for (size_t j = 0; j < n; ++j) {
+                    dual[j].set_adjoint(1.);
+                    DualVec y = F(dual);
+                    for (size_t i = 0; i < m; ++i) jacobian[i][j] = y.at(i).get_adjoint();
+                    dual[j].set_adjoint(0.);
+                }
+                return jacobian;
+            }
+
+            GradientTape& tape = GradientTape::instance();
+            GradientTapeRewind rewind(tape); // also when G or the sweep throws
+
+            VarVec input(x.begin(), x.end());
+            VarVec y = G(input); // record the tape once, then sweep all outputs in a single pass
+            std::vector<node_index_t> outputs(m);
+            for (size_t i = 0; i < m; ++i) outputs[i] = y.at(i).node_gradtape_index;
+            Gradient adjoints;
+            tape.backward_vector(outputs, adjoints);
+            for (size_t i = 0; i < m; ++i)
+                for (size_t j = 0; j < n; ++j) jacobian[i][j] = adjoints.at(input[j].node_gradtape_index * m + i);
+            return jacobian;
+        };
+        return Jf;
+    }
+
     // compute and evaluate gradient on given vector
     RealVec grad_forward(std::function<Dual(const DualVec&)> f, const RealVec& x) {
         auto gradient = grad_forward(f);
@@ -4,19 +4,13 @@
 #include <iostream>
 #include <functional>
 #include <vector>
+#include <algorithm>
 
 #include "dual.hpp"
+#include "dual_n.hpp"
+#include "hyper_dual.hpp"
 #include "tensor.hpp"
-
-template <typename T>
-std::ostream& operator<<(std::ostream& os, const std::vector<T>& v) {
-    os << "[";
-    for (size_t i = 0; i < v.size(); ++i) {
-        os << v[i]; if (i != v.size() - 1) os << ", ";
-    }
-    os << "]";
-    return os;
-}
+#include "var.hpp"
 
 namespace nabla {
 
@@ -34,9 +28,22 @@ std::ostream& operator<<(std::ostream& os, const std::vector<T>& v) {
     using Gradient = std::vector<double>;
     using DualVec = std::vector<Dual>;
     using TensorVec = std::vector<Tensor>;
+    using VarVec = std::vector<Var>;
+    using HyperDualVec = std::vector<HyperDual>;
+    using Jacobian = std::vector<RealVec>; // m rows (outputs) of n columns (inputs)
+    using Hessian = std::vector<RealVec>;
+
+    template <size_t N>
+    using DualNVec = std::vector<DualN<N>>;
+
+    // gradient computation using reverse-mode. f must be a function using nabla::Var (f:R^n->R)
+    std::function<Gradient(const RealVec&)> grad(std::function<Var(const VarVec&)> f);
 
-    // gradient computation using reverse-mode
-    std::function<Gradient(const RealVec&)> grad(std::function<Tensor(const TensorVec&)> f);
+    // gradient of f evaluated at x using reverse-mode, written into `gradient` (resized to n).
+    // f is recorded on the active tape, which is rewound afterwards, and swept into a per-thread
+    // buffer: once the tape, the buffers and `gradient` have grown to the size of f, a call
+    // makes no heap allocation besides those of f itself.
+    void grad(const std::function<Var(const VarVec&)>& f, const RealVec& x, Gradient& gradient);
 
     // derivative a single-valued function f:R->R
     std::function<double(double)> grad_forward(std::function<Dual(Dual)> f);
@@ -49,6 +56,85 @@ std::ostream& operator<<(std::ostream& os, const std::vector<T>& v) {
 
     // directional derivative. F must be a nabla::Dual function
     std::function<double(const RealVec&, const RealVec&)> grad_dir(std::function<Dual(const DualVec&)> F);
+
+    // gradient computation using forward-mode, with the input dimensions split into chunks of
+    // `chunk_size` variables evaluated concurrently on `num_threads` threads. Each thread seeds
+    // its own copy of the dual vector. 0 means all hardware threads / an automatic chunk size.
+    // F must be safe to call concurrently.
+    std::function<RealVec(const RealVec&)> grad_forward_parallel(
+        std::function<Dual(const DualVec&)> F, size_t num_threads=0, size_t chunk_size=0);
+
+    // hessian computation using hyper-dual numbers. F must be a nabla::HyperDual function
+    // (f:R^n->R). Each entry H_ij is obtained exactly from one evaluation seeding e1 on x_i and
+    // e2 on x_j; by symmetry only n(n+1)/2 evaluations are needed
+    std::function<Hessian(const RealVec&)> hessian_forward(std::function<HyperDual(const HyperDualVec&)> F);
+
+    // hessian-vector product H(x)v using hyper-dual numbers. F must be a nabla::HyperDual
+    // function (f:R^n->R). Takes n evaluations, each seeding e1 with v and e2 with one x_i
+    std::function<RealVec(const RealVec&, const RealVec&)> hvp_forward(std::function<HyperDual(const HyperDualVec&)> F);
+
+    // jacobian of F:R^n->R^m using forward-mode, one column per seeded input variable, with
+    // columns evaluated concurrently as in `grad_forward_parallel()`
+    std::function<Jacobian(const RealVec&)> jacobian_forward_parallel(
+        std::function<DualVec(const DualVec&)> F, size_t num_threads=0, size_t chunk_size=0);
+
+    enum class ADMode { forward, reverse };
+
+    // Automatic differentiation mode chosen to compute a jacobian of f:R^n->R^m, together with
+    // the estimated cost of each mode measured in evaluations of f. Forward-mode takes one sweep
+    // per input (n), while reverse-mode takes one recording evaluation plus one tape sweep per
+    // output (1 + m), so forward is chosen when n <= m and reverse otherwise.
+    struct JacobianMode {
+        ADMode mode;
+        size_t inputs;
+        size_t outputs;
+        size_t forward_cost;
+        size_t reverse_cost;
+
+        friend std::ostream& operator<<(std::ostream& os, const JacobianMode& jm) {
+            os << "nabla::JacobianMode[mode: " << (jm.mode == ADMode::forward ? "forward" : "reverse")
+               << ", inputs: " << jm.inputs << ", outputs: " << jm.outputs
+               << ", forward_cost: " << jm.forward_cost << ", reverse_cost: " << jm.reverse_cost << "]";
+            return os;
+        }
+    };
+
+    JacobianMode select_jacobian_mode(size_t inputs, size_t outputs);
+
+    // jacobian of f:R^n->R^m, picking forward-mode (seeded nabla::Dual sweeps of F) or
+    // reverse-mode (gradient tape sweeps of G) according to `select_jacobian_mode()`. F and G
+    // must implement the same function, e.g. nabla::jacobian(f<nabla::Dual>, f<nabla::Var>).
+    // The output dimension is found with an extra unseeded evaluation of F. If given, `on_select`
+    // is called with the chosen mode on every evaluation (e.g. for logging).
+    std::function<Jacobian(const RealVec&)> jacobian(
+        std::function<DualVec(const DualVec&)> F,
+        std::function<VarVec(const VarVec&)> G,
+        std::function<void(const JacobianMode&)> on_select=nullptr);
+
+    // gradient computation using multi-tangent forward-mode. F is evaluated once per chunk of
+    // N input variables, seeding one adjoint per variable in the chunk, so the whole gradient
+    // takes ceil(n / N) evaluations instead of n. Usage: nabla::grad_forward<8>(f<nabla::DualN<8>>)
+    template <size_t N>
+    std::function<RealVec(const RealVec&)> grad_forward(std::function<DualN<N>(const DualNVec<N>&)> F) {
+        static_assert(N > 0, "grad_forward<N> seeds N inputs per evaluation, N must be positive");
+        auto Df = [F](const RealVec& x) -> RealVec {
+            size_t n = x.size(); // dimension
+            DualNVec<N> dual(x.begin(), x.end());
+            RealVec gradient(n);
+
+            for (size_t i = 0; i < n; i += N) {
+                size_t chunk = std::min(N, n - i);
+                for (size_t k = 0; k < chunk; ++k) dual[i + k].set_adjoint(k, 1.); // seed chunk
+                DualN<N> y = F(dual);
+                for (size_t k = 0; k < chunk; ++k) {
+                    gradient[i + k] = y.get_adjoint(k);
+                    dual[i + k].set_adjoint(k, 0.); // unseed for the next chunk
+                }
+            }
+            return gradient;
+        };
+        return Df;
+    }
 }
 
 #endif
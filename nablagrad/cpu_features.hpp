@@ -0,0 +1,40 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// Run-time selection of the vectorized kernels. The library is built for the baseline ISA of
+// the target; on x86-64 with GCC or Clang the kernels are additionally compiled for wider
+// instruction sets through function target attributes, and picked at run time when the CPU
+// supports them.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define NABLA_SIMD_DISPATCH
+#define NABLA_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define NABLA_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+#if defined(__AVX__) || defined(NABLA_SIMD_DISPATCH)
+#include <immintrin.h>
+#endif
+
+namespace nabla {
+    namespace cpu {
+        inline bool has_avx2() {
+#ifdef NABLA_SIMD_DISPATCH
+            static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+            return supported;
+#else
+            return false;
+#endif
+        }
+
+        inline bool has_avx512() {
+#ifdef NABLA_SIMD_DISPATCH
+            static const bool supported = __builtin_cpu_supports("avx512f");
+            return supported;
+#else
+            return false;
+#endif
+        }
+    } // namespace cpu
+} // namespace nabla
+
+#endif // CPU_FEATURES_H
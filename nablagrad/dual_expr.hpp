@@ -0,0 +1,348 @@
+#ifndef DUAL_EXPR_H
+#define DUAL_EXPR_H
+
+#include <iostream>
+#include <cmath>
+#include <type_traits>
+
+namespace nabla {
+    // Header-only, expression-template forward-mode dual numbers. Unlike `nabla::Dual`,
+    // arithmetic on `nabla::et::Dual<T>` does not compute anything: each operator returns a
+    // lightweight expression node, and the whole expression is evaluated in a single fused
+    // primal/tangent pass when it is assigned to a `Dual<T>`. Since everything is inline and
+    // the nodes live on the stack, an expression such as `log(x0) + x0 * x1 - sin(x1)`
+    // compiles down to straight-line scalar code without intermediate dual temporaries.
+    // Arithmetic is `constexpr`; elementary functions are as `constexpr` as their scalar
+    // counterparts for `T`.
+    namespace et {
+        // Primal/tangent pair produced by evaluating an expression node.
+        template <typename T>
+        struct DualValue {
+            T primal;
+            T adjoint;
+        };
+
+        // CRTP base of every dual expression. `E` must provide `constexpr DualValue<T> eval() const`.
+        template <typename T, typename E>
+        struct DualExpr {
+            using scalar_type = T;
+
+            constexpr const E& self() const { return static_cast<const E&>(*this); }
+            constexpr T get_primal() const { return self().eval().primal; }
+            constexpr T get_adjoint() const { return self().eval().adjoint; }
+        };
+
+        template <typename T> struct Dual;
+
+        namespace detail {
+            // Leaves (`Dual<T>` variables) are held by reference; intermediate expression nodes
+            // are temporaries and are held by value so that they outlive the full expression.
+            template <typename E>
+            struct operand { using type = const E; };
+            template <typename T>
+            struct operand<Dual<T>> { using type = const Dual<T>&; };
+            template <typename E>
+            using operand_t = typename operand<E>::type;
+
+            // Prevents deduction of `T` from scalar operands so that e.g. `x * 2` works.
+            template <typename T>
+            struct identity { using type = T; };
+            template <typename T>
+            using nondeduced_t = typename identity<T>::type;
+
+            // x^p for arithmetic scalars; other scalar types (e.g. `nabla::Var`) provide their
+            // own `power(x, double)`, found by argument-dependent lookup
+            template <typename S, typename = std::enable_if_t<std::is_arithmetic<S>::value>>
+            S power(S x, double p) { return S(std::pow(x, p)); }
+        } // namespace detail
+
+        template <typename T>
+        struct Dual : DualExpr<T, Dual<T>> {
+            constexpr Dual() : m_primal{0}, m_adjoint{0} {}
+            constexpr Dual(T primal) : m_primal{primal}, m_adjoint{0} {}
+            constexpr Dual(T primal, T adjoint) : m_primal{primal}, m_adjoint{adjoint} {}
+
+            // Evaluate an expression in a single fused pass.
+            template <typename E>
+            constexpr Dual(const DualExpr<T, E>& e) : m_primal{0}, m_adjoint{0} { assign_(e.self().eval()); }
+
+            template <typename E>
+            constexpr Dual& operator=(const DualExpr<T, E>& e) { assign_(e.self().eval()); return *this; }
+
+            constexpr Dual& operator=(T x) { m_primal = x; m_adjoint = 0; return *this; }
+
+            template <typename E>
+            constexpr Dual& operator+=(const DualExpr<T, E>& e) {
+                DualValue<T> v = e.self().eval();
+                m_primal += v.primal;
+                m_adjoint += v.adjoint;
+                return *this;
+            }
+
+            template <typename E>
+            constexpr Dual& operator-=(const DualExpr<T, E>& e) {
+                DualValue<T> v = e.self().eval();
+                m_primal -= v.primal;
+                m_adjoint -= v.adjoint;
+                return *this;
+            }
+
+            template <typename E>
+            constexpr Dual& operator*=(const DualExpr<T, E>& e) {
+                DualValue<T> v = e.self().eval();
+                m_adjoint = m_adjoint * v.primal + m_primal * v.adjoint;
+                m_primal *= v.primal;
+                return *this;
+            }
+
+            template <typename E>
+            constexpr Dual& operator/=(const DualExpr<T, E>& e) {
+                DualValue<T> v = e.self().eval();
+                m_primal /= v.primal;
+                m_adjoint = (m_adjoint - m_primal * v.adjoint) / v.primal;
+                return *this;
+            }
+
+            constexpr Dual& operator+=(T c) { m_primal += c; return *this; }
+            constexpr Dual& operator-=(T c) { m_primal -= c; return *this; }
+            constexpr Dual& operator*=(T c) { m_primal *= c; m_adjoint *= c; return *this; }
+            constexpr Dual& operator/=(T c) { m_primal /= c; m_adjoint /= c; return *this; }
+
+            constexpr T get_primal() const { return m_primal; }
+            constexpr void set_primal(T val) { m_primal = val; }
+
+            constexpr T get_adjoint() const { return m_adjoint; }
+            constexpr void set_adjoint(T val) { m_adjoint = val; }
+
+            constexpr DualValue<T> eval() const { return {m_primal, m_adjoint}; }
+
+            friend std::ostream& operator<<(std::ostream& os, const Dual& d) {
+                os << "nabla::et::Dual[primal: " << d.m_primal << ", adjoint: " << d.m_adjoint << "]";
+                return os;
+            }
+
+        private:
+            constexpr void assign_(DualValue<T> v) { m_primal = v.primal; m_adjoint = v.adjoint; }
+
+            T m_primal;
+            T m_adjoint;
+        };
+
+        // Binary expression node. `Op::apply(a, b)` combines the evaluated operands.
+        template <typename T, typename L, typename R, typename Op>
+        struct BinaryExpr : DualExpr<T, BinaryExpr<T, L, R, Op>> {
+            constexpr BinaryExpr(const L& l, const R& r) : m_lhs{l}, m_rhs{r} {}
+            constexpr DualValue<T> eval() const { return Op::apply(m_lhs.eval(), m_rhs.eval()); }
+
+        private:
+            detail::operand_t<L> m_lhs;
+            detail::operand_t<R> m_rhs;
+        };
+
+        // Expression node combining a dual expression with a constant of type `S` (a `T`, or a
+        // plain double for exponents).
+        template <typename T, typename E, typename Op, typename S = T>
+        struct ScalarExpr : DualExpr<T, ScalarExpr<T, E, Op, S>> {
+            constexpr ScalarExpr(const E& e, S c) : m_expr{e}, m_scalar{c} {}
+            constexpr DualValue<T> eval() const { return Op::apply(m_expr.eval(), m_scalar); }
+
+        private:
+            detail::operand_t<E> m_expr;
+            S m_scalar;
+        };
+
+        // Unary expression node. `Op::apply(a)` computes the elementary function and its
+        // derivative at the operand's primal.
+        template <typename T, typename E, typename Op>
+        struct UnaryExpr : DualExpr<T, UnaryExpr<T, E, Op>> {
+            constexpr explicit UnaryExpr(const E& e) : m_expr{e} {}
+            constexpr DualValue<T> eval() const { return Op::apply(m_expr.eval()); }
+
+        private:
+            detail::operand_t<E> m_expr;
+        };
+
+        namespace ops {
+            struct Add {
+                template <typename T>
+                static constexpr DualValue<T> apply(DualValue<T> a, DualValue<T> b) {
+                    return {a.primal + b.primal, a.adjoint + b.adjoint};
+                }
+            };
+            struct Sub {
+                template <typename T>
+                static constexpr DualValue<T> apply(DualValue<T> a, DualValue<T> b) {
+                    return {a.primal - b.primal, a.adjoint - b.adjoint};
+                }
+            };
+            struct Mul {
+                template <typename T>
+                static constexpr DualValue<T> apply(DualValue<T> a, DualValue<T> b) {
+                    return {a.primal * b.primal, a.adjoint * b.primal + a.primal * b.adjoint};
+                }
+            };
+            struct Div {
+                template <typename T>
+                static constexpr DualValue<T> apply(DualValue<T> a, DualValue<T> b) {
+                    T q = a.primal / b.primal;
+                    return {q, (a.adjoint - q * b.adjoint) / b.primal};
+                }
+            };
+
+            // scalar on the right (x op c) and on the left (c op x)
+            struct AddScalar {
+                template <typename T>
+                static constexpr DualValue<T> apply(DualValue<T> a, T c) { return {a.primal + c, a.adjoint}; }
+            };
+            struct SubScalar {
+                template <typename T>
+                static constexpr DualValue<T> apply(DualValue<T> a, T c) { return {a.primal - c, a.adjoint}; }
+            };
+            struct ScalarSub {
+                template <typename T>
+                static constexpr DualValue<T> apply(DualValue<T> a, T c) { return {c - a.primal, -a.adjoint}; }
+            };
+            struct MulScalar {
+                template <typename T>
+                static constexpr DualValue<T> apply(DualValue<T> a, T c) { return {a.primal * c, a.adjoint * c}; }
+            };
+            struct DivScalar {
+                template <typename T>
+                static constexpr DualValue<T> apply(DualValue<T> a, T c) { return {a.primal / c, a.adjoint / c}; }
+            };
+            struct ScalarDiv {
+                template <typename T>
+                static constexpr DualValue<T> apply(DualValue<T> a, T c) {
+                    T q = c / a.primal;
+                    return {q, -q * a.adjoint / a.primal};
+                }
+            };
+            struct Power {
+                template <typename T>
+                static DualValue<T> apply(DualValue<T> a, double p) {
+                    using detail::power;
+                    return {power(a.primal, p), a.adjoint * power(a.primal, p - 1) * T(p)};
+                }
+            };
+
+            struct Neg {
+                template <typename T>
+                static constexpr DualValue<T> apply(DualValue<T> a) { return {-a.primal, -a.adjoint}; }
+            };
+            struct Sin {
+                template <typename T>
+                static DualValue<T> apply(DualValue<T> a) {
+                    using std::sin; using std::cos;
+                    return {sin(a.primal), a.adjoint * cos(a.primal)};
+                }
+            };
+            struct Cos {
+                template <typename T>
+                static DualValue<T> apply(DualValue<T> a) {
+                    using std::sin; using std::cos;
+                    return {cos(a.primal), -a.adjoint * sin(a.primal)};
+                }
+            };
+            struct Exp {
+                template <typename T>
+                static DualValue<T> apply(DualValue<T> a) {
+                    using std::exp;
+                    T e = exp(a.primal);
+                    return {e, a.adjoint * e};
+                }
+            };
+            struct Log {
+                template <typename T>
+                static DualValue<T> apply(DualValue<T> a) {
+                    using std::log;
+                    return {log(a.primal), a.adjoint / a.primal};
+                }
+            };
+            struct Abs {
+                template <typename T>
+                static constexpr DualValue<T> apply(DualValue<T> a) {
+                    T sign = a.primal == T(0) ? T(0) : (a.primal > T(0) ? T(1) : T(-1));
+                    return {a.primal * sign, a.adjoint * sign};
+                }
+            };
+            struct Sqrt {
+                template <typename T>
+                static DualValue<T> apply(DualValue<T> a) {
+                    using std::sqrt;
+                    T sq = sqrt(a.primal);
+                    return {sq, T(0.5) * a.adjoint / sq};
+                }
+            };
+        } // namespace ops
+
+        template <typename T, typename L, typename R>
+        constexpr BinaryExpr<T, L, R, ops::Add> operator+(const DualExpr<T, L>& l, const DualExpr<T, R>& r) {
+            return {l.self(), r.self()};
+        }
+        template <typename T, typename L, typename R>
+        constexpr BinaryExpr<T, L, R, ops::Sub> operator-(const DualExpr<T, L>& l, const DualExpr<T, R>& r) {
+            return {l.self(), r.self()};
+        }
+        template <typename T, typename L, typename R>
+        constexpr BinaryExpr<T, L, R, ops::Mul> operator*(const DualExpr<T, L>& l, const DualExpr<T, R>& r) {
+            return {l.self(), r.self()};
+        }
+        template <typename T, typename L, typename R>
+        constexpr BinaryExpr<T, L, R, ops::Div> operator/(const DualExpr<T, L>& l, const DualExpr<T, R>& r) {
+            return {l.self(), r.self()};
+        }
+
+        template <typename T, typename E>
+        constexpr ScalarExpr<T, E, ops::AddScalar> operator+(const DualExpr<T, E>& e, detail::nondeduced_t<T> c) {
+            return {e.self(), c};
+        }
+        template <typename T, typename E>
+        constexpr ScalarExpr<T, E, ops::AddScalar> operator+(detail::nondeduced_t<T> c, const DualExpr<T, E>& e) {
+            return {e.self(), c};
+        }
+        template <typename T, typename E>
+        constexpr ScalarExpr<T, E, ops::SubScalar> operator-(const DualExpr<T, E>& e, detail::nondeduced_t<T> c) {
+            return {e.self(), c};
+        }
+        template <typename T, typename E>
+        constexpr ScalarExpr<T, E, ops::ScalarSub> operator-(detail::nondeduced_t<T> c, const DualExpr<T, E>& e) {
+            return {e.self(), c};
+        }
+        template <typename T, typename E>
+        constexpr ScalarExpr<T, E, ops::MulScalar> operator*(const DualExpr<T, E>& e, detail::nondeduced_t<T> c) {
+            return {e.self(), c};
+        }
+        template <typename T, typename E>
+        constexpr ScalarExpr<T, E, ops::MulScalar> operator*(detail::nondeduced_t<T> c, const DualExpr<T, E>& e) {
+            return {e.self(), c};
+        }
+        template <typename T, typename E>
+        constexpr ScalarExpr<T, E, ops::DivScalar> operator/(const DualExpr<T, E>& e, detail::nondeduced_t<T> c) {
+            return {e.self(), c};
+        }
+        template <typename T, typename E>
+        constexpr ScalarExpr<T, E, ops::ScalarDiv> operator/(detail::nondeduced_t<T> c, const DualExpr<T, E>& e) {
+            return {e.self(), c};
+        }
+
+        template <typename T, typename E>
+        constexpr UnaryExpr<T, E, ops::Neg> operator-(const DualExpr<T, E>& e) { return UnaryExpr<T, E, ops::Neg>(e.self()); }
+
+        template <typename T, typename E>
+        UnaryExpr<T, E, ops::Sin> sin(const DualExpr<T, E>& e) { return UnaryExpr<T, E, ops::Sin>(e.self()); }
+        template <typename T, typename E>
+        UnaryExpr<T, E, ops::Cos> cos(const DualExpr<T, E>& e) { return UnaryExpr<T, E, ops::Cos>(e.self()); }
+        template <typename T, typename E>
+        UnaryExpr<T, E, ops::Exp> exp(const DualExpr<T, E>& e) { return UnaryExpr<T, E, ops::Exp>(e.self()); }
+        template <typename T, typename E>
+        UnaryExpr<T, E, ops::Log> log(const DualExpr<T, E>& e) { return UnaryExpr<T, E, ops::Log>(e.self()); }
+        template <typename T, typename E>
+        constexpr UnaryExpr<T, E, ops::Abs> abs(const DualExpr<T, E>& e) { return UnaryExpr<T, E, ops::Abs>(e.self()); }
+        template <typename T, typename E>
+        UnaryExpr<T, E, ops::Sqrt> sqrt(const DualExpr<T, E>& e) { return UnaryExpr<T, E, ops::Sqrt>(e.self()); }
+        template <typename T, typename E>
+        ScalarExpr<T, E, ops::Power, double> power(const DualExpr<T, E>& e, double p) { return {e.self(), p}; }
+    } // namespace et
+} // namespace nabla
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef DUAL_N_NUMBER_H
+#define DUAL_N_NUMBER_H
+
+#include <iostream>
+#include <cmath>
+#include <array>
+#include <cstddef>
+
+namespace nabla {
+    // Multi-tangent dual number. A `DualN<N>` carries a single primal together with `N`
+    // independent adjoints (tangents), so that evaluating a function on `DualN` numbers
+    // propagates `N` directional derivatives at once while computing the primal only once.
+    // Arithmetic and elementary functions follow the same rules as `nabla::Dual`, applied
+    // to every adjoint component.
+    template <size_t N>
+    struct DualN {
+        static_assert(N > 0, "DualN needs at least one tangent direction");
+
+        constexpr DualN() : m_primal{0.}, m_adjoint{} {}
+        constexpr DualN(double primal) : m_primal{primal}, m_adjoint{} {}
+        constexpr DualN(double primal, const std::array<double, N>& adjoint)
+            : m_primal{primal}, m_adjoint{adjoint} {}
+
+        constexpr double get_primal() const { return this->m_primal; }
+        void set_primal(double val) { this->m_primal = val; }
+
+        constexpr double get_adjoint(size_t i) const { return this->m_adjoint[i]; }
+        void set_adjoint(size_t i, double val) { this->m_adjoint[i] = val; }
+
+        const std::array<double, N>& get_adjoints() const { return this->m_adjoint; }
+
+        static constexpr size_t width() { return N; }
+
+        const DualN& operator=(double x) {
+            this->m_primal = x;
+            this->m_adjoint.fill(0.);
+            return *this;
+        }
+
+        const DualN& operator+=(const DualN& d) {
+            this->m_primal += d.m_primal;
+            for (size_t i = 0; i < N; ++i) this->m_adjoint[i] += d.m_adjoint[i];
+            return *this;
+        }
+
+        friend DualN operator+(const DualN& a, const DualN& b) {
+            DualN r(a.m_primal + b.m_primal);
+            for (size_t i = 0; i < N; ++i) r.m_adjoint[i] = a.m_adjoint[i] + b.m_adjoint[i];
+            return r;
+        }
+
+        friend DualN operator-(const DualN& a, const DualN& b) {
+            DualN r(a.m_primal - b.m_primal);
+            for (size_t i = 0; i < N; ++i) r.m_adjoint[i] = a.m_adjoint[i] - b.m_adjoint[i];
+            return r;
+        }
+
+        friend DualN operator*(const DualN& a, const DualN& b) {
+            DualN r(a.m_primal * b.m_primal);
+            for (size_t i = 0; i < N; ++i)
+                r.m_adjoint[i] = a.m_adjoint[i] * b.m_primal + a.m_primal * b.m_adjoint[i];
+            return r;
+        }
+
+        friend DualN operator/(const DualN& a, const DualN& b) {
+            double inv = 1. / b.m_primal;
+            DualN r(a.m_primal * inv);
+            for (size_t i = 0; i < N; ++i)
+                r.m_adjoint[i] = (a.m_adjoint[i] - r.m_primal * b.m_adjoint[i]) * inv;
+            return r;
+        }
+
+        friend DualN sin(const DualN& d) { return d.chain_(::sin(d.m_primal), ::cos(d.m_primal)); }
+        friend DualN cos(const DualN& d) { return d.chain_(::cos(d.m_primal), -::sin(d.m_primal)); }
+
+        friend DualN exp(const DualN& d) {
+            double e = ::exp(d.m_primal);
+            return d.chain_(e, e);
+        }
+
+        friend DualN log(const DualN& d) { return d.chain_(::log(d.m_primal), 1. / d.m_primal); }
+
+        friend DualN abs(const DualN& d) {
+            int sign = d.m_primal == 0 ? 0 : (d.m_primal > 0 ? 1 : -1);
+            return d.chain_(::fabs(d.m_primal), sign);
+        }
+
+        friend DualN power(const DualN& d, double p) {
+            return d.chain_(::pow(d.m_primal, p), p * ::pow(d.m_primal, p - 1));
+        }
+
+        friend DualN sqrt(const DualN& d) {
+            double sq = ::sqrt(d.m_primal);
+            return d.chain_(sq, 0.5 / sq);
+        }
+
+        friend std::ostream& operator<<(std::ostream& os, const DualN& d) {
+            os << "nabla::DualN[primal: " << d.m_primal << ", adjoint: [";
+            for (size_t i = 0; i < N; ++i) { os << d.m_adjoint[i]; if (i != N - 1) os << ", "; }
+            os << "]]";
+            return os;
+        }
+
+    private:
+        // Apply the chain rule for an elementary function with value `primal` and
+        // derivative `derivative` at this dual number's primal.
+        DualN chain_(double primal, double derivative) const {
+            DualN r(primal);
+            for (size_t i = 0; i < N; ++i) r.m_adjoint[i] = derivative * this->m_adjoint[i];
+            return r;
+        }
+
+        double m_primal;
+        std::array<double, N> m_adjoint;
+    };
+}
+
+#endif
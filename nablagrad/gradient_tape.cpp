@@ -1,29 +1,373 @@
 #include "gradient_tape.hpp"
+#include "tape_file.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
 
 namespace nabla {
-    ComputationNode::ComputationNode(const std::string& node_name,
-                                     std::pair<double, double> local_grad,
-                                     std::pair<node_index_t, node_index_t> tensor_indices) 
-        : m_node_name{node_name}, m_local_grad{local_grad}, m_tensor_indices{tensor_indices} {}
+    const char* op_kind_name(OpKind kind) {
+        switch (kind) {
+            case OpKind::leaf: return "leaf";
+            case OpKind::add: return "add";
+            case OpKind::sub: return "sub";
+            case OpKind::mul: return "mul";
+            case OpKind::div: return "div";
+            case OpKind::exp: return "exp";
+            case OpKind::log: return "log";
+            case OpKind::power: return "power";
+            case OpKind::sin: return "sin";
+            case OpKind::cos: return "cos";
+            case OpKind::abs: return "abs";
+            case OpKind::sqrt: return "sqrt";
+        }
+        return "unknown";
+    }
+
+    GradientTape::GradientTape() = default;
+    GradientTape::GradientTape(size_t node_budget) : m_node_budget{node_budget} { this->reserve(node_budget); }
+    GradientTape::~GradientTape() = default;
+
+    void GradientTape::spill_to(const std::string& path, size_t threshold) {
+        if (threshold == 0) throw std::invalid_argument("spill_to: threshold must be positive");
+        if (this->m_spill_writer) throw std::logic_error("spill_to: the tape is already spilling");
+        this->m_spill_writer = std::make_unique<TapeFileWriter>(path);
+        this->m_spill_threshold = threshold;
+    }
+
+    size_t GradientTape::finish_spill() {
+        if (!this->m_spill_writer) throw std::logic_error("finish_spill: the tape is not spilling");
+        this->flush_spill_();
+        this->m_spill_writer->close();
+        size_t nodes = this->m_spill_writer->size();
+        this->m_spill_writer.reset();
+        return nodes;
+    }
+
+    void GradientTape::flush_spill_() {
+        this->m_spill_writer->write(this->m_weight0.data(), this->m_weight1.data(),
+            this->m_parent0.data(), this->m_parent1.data(), this->m_weight0.size());
+        this->m_spilled += this->m_weight0.size();
+        this->m_weight0.clear();
+        this->m_weight1.clear();
+        this->m_parent0.clear();
+        this->m_parent1.clear();
+#ifndef NDEBUG
+        this->m_op_kinds.clear();
+#endif
+    }
+
+    void GradientTape::list() {
+        const GradientTape& gt = instance();
+        std::cout << "nabla::GradientTape[tape:" << std::endl;
+        for (size_t i = 0; i < gt.size(); ++i)
+            std::cout << "   " << gt.get_node_name(i) << ": " << gt.get_computation_node(i) << std::endl;
+        std::cout << "]" << std::endl;
+    }
+
+    void GradientTape::rewind(mark_t mark) {
+        if (mark > this->size()) throw std::out_of_range("rewind: mark is past the end of the tape");
+        size_t local_size = this->local_index_(mark);
+        this->m_weight0.resize(local_size);
+        this->m_weight1.resize(local_size);
+        this->m_parent0.resize(local_size);
+        this->m_parent1.resize(local_size);
+#ifndef NDEBUG
+        this->m_op_kinds.resize(local_size);
+#endif
+    }
+
+    void GradientTape::clear_() {
+        this->m_spill_writer.reset();
+        this->m_spill_threshold = 0;
+        this->m_spilled = 0;
+        this->rewind(0);
+    }
+
+    void GradientTape::reserve(size_t nodes) {
+        this->m_weight0.reserve(nodes);
+        this->m_weight1.reserve(nodes);
+        this->m_parent0.reserve(nodes);
+        this->m_parent1.reserve(nodes);
+#ifndef NDEBUG
+        this->m_op_kinds.reserve(nodes);
+#endif
+    }
+
+    std::vector<ComputationNode> GradientTape::get_tape() const {
+        std::vector<ComputationNode> nodes;
+        nodes.reserve(this->size());
+        for (size_t i = 0; i < this->size(); ++i) nodes.push_back(this->get_computation_node(i));
+        return nodes;
+    }
+
+    std::string GradientTape::get_node_name(node_index_t index) const {
+#ifndef NDEBUG
+        return std::string(op_kind_name(this->m_op_kinds.at(this->local_index_(index)))) + "_" + std::to_string(index);
+#else
+        return "node_" + std::to_string(index);
+#endif
+    }
 
     node_index_t GradientTape::push_node(
-        const std::string& node_name,
+        OpKind kind,
         const std::pair<double, double>& local_grad,
         const std::pair<node_index_t, node_index_t>& tensor_indices
     ) {
-        size_t gradient_tape_size = this->tape.size();
-        this->tape.emplace_back(ComputationNode(node_name, local_grad, tensor_indices));
+        size_t gradient_tape_size = this->size();
+#ifndef NDEBUG
+        profiler::RecordTimer timer(kind, 2 * sizeof(double) + 2 * sizeof(node_index_t) + sizeof(OpKind));
+#else
+        profiler::RecordTimer timer(kind, 2 * sizeof(double) + 2 * sizeof(node_index_t));
+#endif
+        if (this->m_spill_writer && this->m_weight0.size() == this->m_spill_threshold) this->flush_spill_();
+        if (this->m_node_budget != 0 && this->m_weight0.size() == this->m_node_budget)
+            throw std::length_error("push_node: gradient tape node budget exhausted");
+        this->m_weight0.push_back(local_grad.first);
+        this->m_weight1.push_back(local_grad.second);
+        this->m_parent0.push_back(tensor_indices.first);
+        this->m_parent1.push_back(tensor_indices.second);
+#ifndef NDEBUG
+        this->m_op_kinds.push_back(kind);
+#else
+        (void)kind;
+#endif
         return gradient_tape_size;
     }
 
-    node_index_t GradientTape::push_node(const std::string& node_name, double weight, node_index_t tensor_index) {
-        size_t gradient_tape_size = this->tape.size();
-        return this->push_node(node_name, { weight, 0. }, { tensor_index, gradient_tape_size });
+    node_index_t GradientTape::push_node(OpKind kind, double weight, node_index_t tensor_index) {
+        node_index_t gradient_tape_size = this->size();
+        return this->push_node(kind, { weight, 0. }, { tensor_index, gradient_tape_size });
+    }
+
+    node_index_t GradientTape::push_leaf_node() {
+        node_index_t gradient_tape_size = this->size();
+        return this->push_node(OpKind::leaf, { 0., 0. }, { gradient_tape_size, gradient_tape_size });
+    }
+
+    std::vector<double> GradientTape::backward(node_index_t output) const {
+        std::vector<double> adjoints;
+        this->backward(output, adjoints);
+        return adjoints;
+    }
+
+    void GradientTape::backward(node_index_t output, std::vector<double>& adjoints) const {
+        profiler::SweepTimer timer(profiler::Sweep::backward, size_t(output) + 1);
+        adjoints.assign(this->size(), 0.);
+        adjoints.at(output) = 1.;
+        this->sweep_(output, adjoints);
     }
 
-    node_index_t GradientTape::push_leaf_node(const std::string& node_name) {
-        size_t gradient_tape_size = this->tape.size();
-        std::string name = "leaf_" + std::to_string(ComputationNode::node_id_generator++);
-        return this->push_node(name, { 0., 0. }, { gradient_tape_size, gradient_tape_size });
+    void GradientTape::backward(const std::vector<node_index_t>& outputs, const std::vector<double>& seeds,
+                                std::vector<double>& adjoints) const {
+        if (outputs.size() != seeds.size())
+            throw std::invalid_argument("backward: outputs and seeds sizes differ");
+
+        adjoints.assign(this->size(), 0.);
+        node_index_t output = -1;
+        for (size_t k = 0; k < outputs.size(); ++k) {
+            adjoints.at(outputs[k]) += seeds[k];
+            output = std::max(output, outputs[k]);
+        }
+        profiler::SweepTimer timer(profiler::Sweep::backward, size_t(output) + 1);
+        this->sweep_(output, adjoints);
+    }
+
+    void GradientTape::backward_vector(const std::vector<node_index_t>& outputs,
+                                       std::vector<double>& adjoints) const {
+        if (this->m_spilled > 0)
+            throw std::logic_error("backward_vector: the tape was spilled to disk, use backward_from_file()");
+
+        const size_t k = outputs.size();
+        profiler::SweepTimer timer(profiler::Sweep::backward_vector, this->size());
+        adjoints.assign(this->size() * k, 0.);
+        node_index_t output = -1;
+        for (size_t j = 0; j < k; ++j) {
+            adjoints.at(outputs[j] * k + j) = 1.;
+            output = std::max(output, outputs[j]);
+        }
+
+        const double* weight0 = this->m_weight0.data();
+        const double* weight1 = this->m_weight1.data();
+        const node_index_t* parent0 = this->m_parent0.data();
+        const node_index_t* parent1 = this->m_parent1.data();
+        double* lanes = adjoints.data();
+
+        for (node_index_t i = output; i >= 0; --i) {
+            const double* adjoint = lanes + i * k;
+            // Leaves and unary nodes point their unused dependencies back at themselves with a
+            // zero weight; skipping those keeps the lane loops free of self-aliasing.
+            if (parent0[i] != i) {
+                double* parent = lanes + parent0[i] * k;
+                const double w = weight0[i];
+                for (size_t j = 0; j < k; ++j) parent[j] += w * adjoint[j];
+            }
+            if (parent1[i] != i) {
+                double* parent = lanes + parent1[i] * k;
+                const double w = weight1[i];
+                for (size_t j = 0; j < k; ++j) parent[j] += w * adjoint[j];
+            }
+        }
+    }
+
+    namespace {
+        // Levels holding at least this many nodes are swept in parallel
+        constexpr size_t parallel_level_width = 4096;
+
+        // Contiguous run of the level-sorted nodes swept between two barriers, either split
+        // across all threads (a single wide level) or by one thread (a run of narrow levels)
+        struct SweepPhase {
+            size_t begin;
+            size_t end;
+            bool parallel;
+        };
+
+        void atomic_add(std::atomic<double>& target, double value) {
+            double current = target.load(std::memory_order_relaxed);
+            while (!target.compare_exchange_weak(current, current + value, std::memory_order_relaxed)) {}
+        }
+    } // namespace
+
+    void GradientTape::backward_parallel(node_index_t output, std::vector<double>& adjoints,
+                                         size_t num_threads, bool deterministic) const {
+        if (this->m_spilled > 0)
+            throw std::logic_error("backward_parallel: the tape was spilled to disk, use backward_from_file()");
+        if (num_threads == 0) num_threads = parallel::default_num_threads();
+        profiler::SweepTimer timer(profiler::Sweep::backward_parallel, size_t(output) + 1);
+
+        adjoints.assign(this->size(), 0.);
+        adjoints.at(output) = 1.;
+
+        const double* weight0 = this->m_weight0.data();
+        const double* weight1 = this->m_weight1.data();
+        const node_index_t* parent0 = this->m_parent0.data();
+        const node_index_t* parent1 = this->m_parent1.data();
+        const size_t n = size_t(output) + 1;
+
+        // Dependency level of every node up to the output. Leaves and unary nodes point their
+        // unused dependencies back at themselves, these self edges are ignored throughout.
+        std::vector<node_index_t> level(n);
+        node_index_t num_levels = 0;
+        for (size_t i = 0; i < n; ++i) {
+            node_index_t l = 0;
+            if (size_t(parent0[i]) != i) l = level[parent0[i]] + 1;
+            if (size_t(parent1[i]) != i) l = std::max(l, level[parent1[i]] + 1);
+            level[i] = l;
+            num_levels = std::max(num_levels, l + 1);
+        }
+
+        // Nodes sorted by level (counting sort)
+        std::vector<size_t> level_ptr(num_levels + 1, 0);
+        for (size_t i = 0; i < n; ++i) ++level_ptr[level[i] + 1];
+        for (node_index_t l = 0; l < num_levels; ++l) level_ptr[l + 1] += level_ptr[l];
+        std::vector<node_index_t> order(n);
+        {
+            std::vector<size_t> fill(level_ptr.begin(), level_ptr.end() - 1);
+            for (size_t i = 0; i < n; ++i) order[fill[level[i]]++] = node_index_t(i);
+        }
+
+        // Consecutive narrow levels are merged into a single serial phase
+        std::vector<SweepPhase> phases;
+        bool any_parallel = false;
+        for (node_index_t l = num_levels - 1; l >= 0; --l) {
+            size_t begin = level_ptr[l], end = level_ptr[l + 1];
+            bool wide = end - begin >= parallel_level_width;
+            any_parallel |= wide;
+            if (!wide && !phases.empty() && !phases.back().parallel) phases.back().begin = begin;
+            else phases.push_back({ begin, end, wide });
+        }
+        if (num_threads <= 1 || !any_parallel) {
+            this->sweep_(output, adjoints);
+            return;
+        }
+
+        // Per-node kernel: either gather the adjoint of a node from the nodes depending on it, or
+        // scatter the adjoint of a node to its dependencies
+        std::function<void(size_t)> sweep_node;
+        std::vector<size_t> consumer_ptr;
+        std::vector<size_t> consumer_edges; // 2 * consumer + operand slot
+        std::vector<std::atomic<double>> scattered;
+
+        if (deterministic) {
+            consumer_ptr.assign(n + 1, 0);
+            for (size_t j = 0; j < n; ++j) {
+                if (size_t(parent0[j]) != j) ++consumer_ptr[parent0[j] + 1];
+                if (size_t(parent1[j]) != j) ++consumer_ptr[parent1[j] + 1];
+            }
+            for (size_t i = 0; i < n; ++i) consumer_ptr[i + 1] += consumer_ptr[i];
+            consumer_edges.resize(consumer_ptr[n]);
+            std::vector<size_t> fill(consumer_ptr.begin(), consumer_ptr.end() - 1);
+            // Fill consumers from the last node down, so each list is in sequential sweep order
+            for (size_t j = n; j-- > 0;) {
+                if (size_t(parent0[j]) != j) consumer_edges[fill[parent0[j]]++] = 2 * j;
+                if (size_t(parent1[j]) != j) consumer_edges[fill[parent1[j]]++] = 2 * j + 1;
+            }
+
+            double* adjoint = adjoints.data();
+            sweep_node = [&, adjoint](size_t i) {
+                double sum = adjoint[i];
+                for (size_t e = consumer_ptr[i]; e < consumer_ptr[i + 1]; ++e) {
+                    size_t j = consumer_edges[e] >> 1;
+                    if (adjoint[j] == 0.) continue;
+                    sum += ((consumer_edges[e] & 1) ? weight1[j] : weight0[j]) * adjoint[j];
+                }
+                adjoint[i] = sum;
+            };
+        } else {
+            scattered = std::vector<std::atomic<double>>(n);
+            for (auto& a : scattered) a.store(0., std::memory_order_relaxed);
+            scattered[output].store(1., std::memory_order_relaxed);
+
+            sweep_node = [&](size_t j) {
+                double adjoint = scattered[j].load(std::memory_order_relaxed);
+                if (adjoint == 0.) return;
+                if (size_t(parent0[j]) != j) atomic_add(scattered[parent0[j]], weight0[j] * adjoint);
+                if (size_t(parent1[j]) != j) atomic_add(scattered[parent1[j]], weight1[j] * adjoint);
+            };
+        }
+
+        // Threads are spawned once; each phase ends on a barrier, which also publishes the
+        // adjoints of the phase to the next one
+        parallel::Barrier barrier(num_threads);
+        auto worker = [&](size_t thread_id) {
+            for (const SweepPhase& phase : phases) {
+                if (phase.parallel) {
+                    size_t width = phase.end - phase.begin;
+                    size_t begin = phase.begin + width * thread_id / num_threads;
+                    size_t end = phase.begin + width * (thread_id + 1) / num_threads;
+                    for (size_t k = begin; k < end; ++k) sweep_node(order[k]);
+                } else if (thread_id == 0) {
+                    for (size_t k = phase.end; k-- > phase.begin;) sweep_node(order[k]);
+                }
+                barrier.wait();
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(num_threads - 1);
+        for (size_t t = 1; t < num_threads; ++t) workers.emplace_back(worker, t);
+        worker(0);
+        for (auto& w : workers) w.join();
+
+        if (!deterministic)
+            for (size_t i = 0; i < n; ++i) adjoints[i] = scattered[i].load(std::memory_order_relaxed);
+    }
+
+    void GradientTape::sweep_(node_index_t output, std::vector<double>& adjoints) const {
+        if (this->m_spilled > 0)
+            throw std::logic_error("backward: the tape was spilled to disk, use backward_from_file()");
+
+        const double* weight0 = this->m_weight0.data();
+        const double* weight1 = this->m_weight1.data();
+        const node_index_t* parent0 = this->m_parent0.data();
+        const node_index_t* parent1 = this->m_parent1.data();
+
+        for (node_index_t i = output; i >= 0; --i) {
+            double adjoint = adjoints[i];
+            if (adjoint == 0.) continue;
+            adjoints[parent0[i]] += weight0[i] * adjoint;
+            adjoints[parent1[i]] += weight1[i] * adjoint;
+        }
     }
-} // namespace nabla
\ No newline at end of file
+} // namespace nabla
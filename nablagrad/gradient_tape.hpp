@@ -3,73 +3,209 @@
 
 #include <iostream>
 #include <vector>
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+#include <memory>
 
 namespace nabla {
     using node_index_t = int32_t;
 
+    struct TapeFileWriter;
+
+    // Kind of the operation recorded by a node in the gradient tape. Only kept (in the tape's
+    // debug side table) in builds without NDEBUG, for listing the tape.
+    enum class OpKind : uint8_t { leaf, add, sub, mul, div, exp, log, power, sin, cos, abs, sqrt };
+
+    const char* op_kind_name(OpKind kind);
+
     // Node in the computational graph used for tracing a tensor operation. Each
-    // node stores the indices of the input tensors in the gradient tape, its
-    // associated tensor (reference or value, depending on whether is a leaf node
-    // or not) and the local gradient of the computation node, that is, the
-    // corresponding weights for the dependency tensor operands.
+    // node stores the indices of the input tensors in the gradient tape and the local
+    // gradient of the computation node, that is, the corresponding weights for the
+    // dependency tensor operands. The tape does not store nodes themselves (see
+    // `GradientTape`); this is just a by-value view of one of its entries.
     struct ComputationNode {
-        ComputationNode(const std::string& node_name,
-                        std::pair<double, double> local_grad,
-                        std::pair<node_index_t, node_index_t> tensor_indices);
+        ComputationNode(std::pair<double, double> local_grad,
+                        std::pair<node_index_t, node_index_t> tensor_indices)
+            : m_local_grad{local_grad}, m_tensor_indices{tensor_indices} {}
 
-        const std::string& get_name() const { return this->m_node_name; }
         const std::pair<double, double>& get_local_grad() const { return this->m_local_grad; }
         const std::pair<node_index_t, node_index_t>& get_tensor_dependencies() const {
             return this->m_tensor_indices;
         }
 
         friend std::ostream& operator<<(std::ostream& os, const ComputationNode& node) {
-            os << "nabla::ComputationNode[name: " << node.get_name()
-               << ", local_grad: [" << node.get_local_grad().first << ", " << node.get_local_grad().second
-               << "], dependencies_indices: [" << node.get_tensor_dependencies().first
-               << ", " << node.get_tensor_dependencies().second << "]]";
+            os << "nabla::ComputationNode[local_grad: [" << node.get_local_grad().first << ", "
+               << node.get_local_grad().second << "], dependencies_indices: ["
+               << node.get_tensor_dependencies().first << ", " << node.get_tensor_dependencies().second << "]]";
             return os;
         }
 
-        static inline unsigned int node_id_generator = 0;
-
     private:
-        std::string m_node_name;
         std::pair<double, double> m_local_grad;
         std::pair<node_index_t, node_index_t> m_tensor_indices;
     };
 
+    // Gradient tape (Wengert list) recording every operation on reverse-mode variables. The tape
+    // is stored as a struct of arrays: the two local gradient weights and the two dependency
+    // indices of each node live in separate contiguous arrays (24 bytes per node), so that the
+    // reverse sweep streams through memory. Op kinds are kept in a side table in debug builds only.
+    //
+    // Operations are recorded on the active tape of the calling thread, returned by `instance()`.
+    // Every thread starts with its own default tape, so independent reverse-mode computations can
+    // run concurrently on different threads without any locking; a `GradientTapeScope` activates
+    // a user-owned tape instead. A tape must not be recorded on by more than one thread at a time.
     struct GradientTape {
+        // Position in a gradient tape, as returned by `mark()`
+        using mark_t = size_t;
+
+        GradientTape();
+        // Arena mode: preallocate storage for `node_budget` nodes up front. Recording never
+        // reallocates; pushing more than `node_budget` nodes throws std::length_error.
+        explicit GradientTape(size_t node_budget);
         GradientTape(const GradientTape&) = delete;
+        ~GradientTape();
 
-        static GradientTape& instance() {
-            static GradientTape s_instance;
-            return s_instance;
-        }
+        static GradientTape& instance() { return *active_tape_(); }
 
-        static void clean() { instance().tape = std::vector<ComputationNode>(); }
+        // Discard every node of the active tape and stop spilling. The allocated capacity and
+        // the arena node budget are kept, so an arena tape stays preallocated.
+        static void clean() { instance().clear_(); }
 
-        static void list() {
-            std::cout << "nabla::GradientTape[tape:" << std::endl;
-            for (const auto& node : instance().tape)
-                std::cout << "   " << node << std::endl;
-        }
+        // Current position of the tape. Rewinding to it later drops every node recorded after
+        // the mark while keeping the allocated capacity, so re-recording a computation of the
+        // same size does no heap allocation.
+        mark_t mark() const { return this->size(); }
+        void rewind(mark_t mark);
+
+        void reserve(size_t nodes);
+        size_t capacity() const { return this->m_weight0.capacity(); }
+        size_t node_budget() const { return this->m_node_budget; }
 
-        std::vector<ComputationNode> get_tape() const { return this->tape; }
-        const ComputationNode& get_computation_node(node_index_t index) const {
-            return this->tape.at(index);
+        // Spill mode: whenever `threshold` nodes are held in memory, stream them to the tape file
+        // at `path` (see `tape_file.hpp`) and release them from memory. Node indices keep counting
+        // across spills. Spilled nodes cannot be rewound nor swept in memory: call `finish_spill()`
+        // and sweep the file with `backward_from_file()`.
+        void spill_to(const std::string& path, size_t threshold);
+        // Write the nodes still in memory to the tape file and close it. Returns the number of
+        // nodes in the file.
+        size_t finish_spill();
+        // Number of nodes streamed to disk so far
+        size_t spilled() const { return this->m_spilled; }
+
+        static void list();
+
+        // Number of nodes recorded, including spilled ones
+        size_t size() const { return this->m_spilled + this->m_weight0.size(); }
+
+        std::vector<ComputationNode> get_tape() const;
+        ComputationNode get_computation_node(node_index_t index) const {
+            size_t i = this->local_index_(index);
+            return ComputationNode({ this->m_weight0.at(i), this->m_weight1.at(i) },
+                                   { this->m_parent0.at(i), this->m_parent1.at(i) });
         }
 
+        // Name of a node in the tape, e.g. `mul_12`. Op kinds are only recorded in debug builds;
+        // otherwise every node is named `node_<index>`.
+        std::string get_node_name(node_index_t index) const;
+
         node_index_t push_node(
-            const std::string& node_name,
+            OpKind kind,
             const std::pair<double, double>& local_grad,
             const std::pair<node_index_t, node_index_t>& tensor_indices);
-        node_index_t push_node(const std::string& node_name, double weight, node_index_t tensor_index);
-        node_index_t push_leaf_node(const std::string& node_name);
+        node_index_t push_node(OpKind kind, double weight, node_index_t tensor_index);
+        node_index_t push_leaf_node();
+
+        // Reverse sweep over the tape seeded with an adjoint of 1 at node `output`. Returns the
+        // adjoint of every node in the tape (nodes recorded after `output` have adjoint 0).
+        std::vector<double> backward(node_index_t output) const;
+        // Same as above, writing into `adjoints` (resized to the tape size) so its storage can be
+        // reused across sweeps.
+        void backward(node_index_t output, std::vector<double>& adjoints) const;
+        // Reverse sweep seeded with adjoint `seeds[i]` at node `outputs[i]` for every i, i.e. the
+        // vector-jacobian product of the seeds with the outputs.
+        void backward(const std::vector<node_index_t>& outputs, const std::vector<double>& seeds,
+                      std::vector<double>& adjoints) const;
+        // Vector-mode reverse sweep carrying k = outputs.size() adjoints per node, lane j seeded
+        // with an adjoint of 1 at node `outputs[j]`. `adjoints` is resized to size() * k and holds
+        // the adjoint of node i in lane j at index i * k + j. Every tape entry is read once for all
+        // k lanes, so this costs one pass over the tape instead of k.
+        void backward_vector(const std::vector<node_index_t>& outputs, std::vector<double>& adjoints) const;
+        // Parallel reverse sweep seeded with an adjoint of 1 at node `output`. Nodes are grouped
+        // by dependency level (a node's level is one more than the highest level of its
+        // dependencies) and levels are swept from the deepest down; the nodes of a wide level are
+        // split across `num_threads` threads (0 means all hardware threads), narrow levels run on
+        // a single thread. With `deterministic` set every adjoint is gathered from the nodes that
+        // depend on it in the same order as the sequential sweep, so the result is bitwise
+        // identical to `backward(output, adjoints)`; otherwise adjoints are scattered with atomic
+        // adds, which skips building the reverse edges but rounds in scheduling order.
+        void backward_parallel(node_index_t output, std::vector<double>& adjoints,
+                               size_t num_threads = 0, bool deterministic = false) const;
+
+    private:
+        friend struct GradientTapeScope;
+
+        // Propagate the adjoints already seeded in `adjoints` from node `output` down to node 0
+        void sweep_(node_index_t output, std::vector<double>& adjoints) const;
+
+        // Index of a node in the in-memory arrays
+        size_t local_index_(node_index_t index) const {
+            if (size_t(index) < this->m_spilled) throw std::out_of_range("gradient tape node was spilled to disk");
+            return index - this->m_spilled;
+        }
+        void flush_spill_();
+        void clear_();
+
+        static GradientTape*& active_tape_() {
+            thread_local GradientTape default_tape;
+            thread_local GradientTape* active_tape = &default_tape;
+            return active_tape;
+        }
+
+        size_t m_node_budget = 0; // 0 means unbounded
+        size_t m_spilled = 0;
+        size_t m_spill_threshold = 0;
+        std::unique_ptr<TapeFileWriter> m_spill_writer;
+        std::vector<double> m_weight0{};
+        std::vector<double> m_weight1{};
+        std::vector<node_index_t> m_parent0{};
+        std::vector<node_index_t> m_parent1{};
+#ifndef NDEBUG
+        std::vector<OpKind> m_op_kinds{};
+#endif
+    };
+
+    // RAII guard making `tape` the active gradient tape of the calling thread for its lifetime.
+    // The previously active tape is restored on destruction, so scopes can be nested.
+    struct GradientTapeScope {
+        explicit GradientTapeScope(GradientTape& tape) : m_previous{GradientTape::active_tape_()} {
+            GradientTape::active_tape_() = &tape;
+        }
+        ~GradientTapeScope() { GradientTape::active_tape_() = this->m_previous; }
+
+        GradientTapeScope(const GradientTapeScope&) = delete;
+        GradientTapeScope& operator=(const GradientTapeScope&) = delete;
+
+    private:
+        GradientTape* m_previous;
+    };
+
+    // RAII guard rewinding `tape` to its position at construction (see `GradientTape::mark()`)
+    // when destroyed, so that a temporary recording is dropped even when it throws. Nodes
+    // spilled to disk in the meantime cannot be rewound and are kept.
+    struct GradientTapeRewind {
+        explicit GradientTapeRewind(GradientTape& tape) : m_tape{tape}, m_mark{tape.mark()} {}
+        ~GradientTapeRewind() {
+            if (this->m_mark >= this->m_tape.spilled() && this->m_mark <= this->m_tape.size())
+                this->m_tape.rewind(this->m_mark);
+        }
+
+        GradientTapeRewind(const GradientTapeRewind&) = delete;
+        GradientTapeRewind& operator=(const GradientTapeRewind&) = delete;
 
     private:
-        GradientTape() {}
-        std::vector<ComputationNode> tape{};
+        GradientTape& m_tape;
+        GradientTape::mark_t m_mark;
     };
 } // namespace nabla
 
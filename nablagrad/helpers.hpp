@@ -17,17 +17,21 @@ std::ostream& operator<<(std::ostream& os, const std::vector<T>& v) {
     return os;
 }
 
-template<typename T>
-std::vector<T> generate_rand_vect(size_t length) {
-    std::vector<T> random_vect;
-    random_vect.reserve(length);
-
+// Overwrite the elements of `v` with uniform random numbers in [0, 1)
+template<typename T, typename Alloc>
+void fill_rand_vect(std::vector<T, Alloc>& v) {
     std::random_device rd;
     std::mt19937 gen(rd());
     std::uniform_real_distribution<T> U(0, 1);
 
-    for (size_t i = 0; i < length; i++)
-        random_vect.push_back(U(gen));
+    for (T& x : v)
+        x = U(gen);
+}
+
+template<typename T>
+std::vector<T> generate_rand_vect(size_t length) {
+    std::vector<T> random_vect(length);
+    fill_rand_vect(random_vect);
     return random_vect;
 }
 
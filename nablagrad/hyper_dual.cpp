@@ -0,0 +1,83 @@
+#include "hyper_dual.hpp"
+
+namespace nabla {
+    const HyperDual& HyperDual::operator=(double x) {
+        this->m_primal = x;
+        this->m_adjoint1 = 0.;
+        this->m_adjoint2 = 0.;
+        this->m_adjoint12 = 0.;
+        return *this;
+    }
+
+    const HyperDual& HyperDual::operator+=(const HyperDual& d) {
+        this->m_primal += d.m_primal;
+        this->m_adjoint1 += d.m_adjoint1;
+        this->m_adjoint2 += d.m_adjoint2;
+        this->m_adjoint12 += d.m_adjoint12;
+        return *this;
+    }
+
+    HyperDual HyperDual::operator+(const HyperDual& d) const {
+        return HyperDual(this->m_primal + d.m_primal, this->m_adjoint1 + d.m_adjoint1,
+            this->m_adjoint2 + d.m_adjoint2, this->m_adjoint12 + d.m_adjoint12);
+    }
+
+    HyperDual HyperDual::operator-(const HyperDual& d) const {
+        return HyperDual(this->m_primal - d.m_primal, this->m_adjoint1 - d.m_adjoint1,
+            this->m_adjoint2 - d.m_adjoint2, this->m_adjoint12 - d.m_adjoint12);
+    }
+
+    HyperDual HyperDual::operator*(const HyperDual& d) const {
+        return HyperDual(this->m_primal * d.m_primal,
+            this->m_adjoint1 * d.m_primal + this->m_primal * d.m_adjoint1,
+            this->m_adjoint2 * d.m_primal + this->m_primal * d.m_adjoint2,
+            this->m_adjoint12 * d.m_primal + this->m_adjoint1 * d.m_adjoint2
+                + this->m_adjoint2 * d.m_adjoint1 + this->m_primal * d.m_adjoint12);
+    }
+
+    HyperDual HyperDual::operator/(const HyperDual& d) const {
+        // a / b = a * (1 / b), where 1/x has derivatives -1/x^2 and 2/x^3
+        double inv = 1. / d.m_primal;
+        return *this * d.chain_(inv, -inv * inv, 2. * inv * inv * inv);
+    }
+
+    HyperDual HyperDual::chain_(double f0, double f1, double f2) const {
+        return HyperDual(f0, f1 * this->m_adjoint1, f1 * this->m_adjoint2,
+            f1 * this->m_adjoint12 + f2 * this->m_adjoint1 * this->m_adjoint2);
+    }
+
+    HyperDual sin(const HyperDual& d) {
+        double s = ::sin(d.m_primal);
+        return d.chain_(s, ::cos(d.m_primal), -s);
+    }
+
+    HyperDual cos(const HyperDual& d) {
+        double c = ::cos(d.m_primal);
+        return d.chain_(c, -::sin(d.m_primal), -c);
+    }
+
+    HyperDual exp(const HyperDual& d) {
+        double e = ::exp(d.m_primal);
+        return d.chain_(e, e, e);
+    }
+
+    HyperDual log(const HyperDual& d) {
+        double inv = 1. / d.m_primal;
+        return d.chain_(::log(d.m_primal), inv, -inv * inv);
+    }
+
+    HyperDual abs(const HyperDual& d) {
+        int sign = d.m_primal == 0 ? 0 : (d.m_primal > 0 ? 1 : -1);
+        return d.chain_(::fabs(d.m_primal), sign, 0.);
+    }
+
+    HyperDual power(const HyperDual& d, double p) {
+        return d.chain_(::pow(d.m_primal, p), p * ::pow(d.m_primal, p - 1),
+            p * (p - 1) * ::pow(d.m_primal, p - 2));
+    }
+
+    HyperDual sqrt(const HyperDual& d) {
+        double sq = ::sqrt(d.m_primal);
+        return d.chain_(sq, 0.5 / sq, -0.25 / (sq * d.m_primal));
+    }
+}
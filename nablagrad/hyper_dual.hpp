@@ -0,0 +1,65 @@
+#ifndef HYPER_DUAL_NUMBER_H
+#define HYPER_DUAL_NUMBER_H
+
+#include <iostream>
+#include <cmath>
+
+namespace nabla {
+    // Representation of a hyper-dual number. Hyper-dual numbers are of the form
+    // `x + y1 e1 + y2 e2 + y12 e1e2`, where e1^2 = e2^2 = 0 and e1, e2, e1e2 != 0. Evaluating a
+    // function on a hyper-dual number with `y1` and `y2` seeded with directions u and v gives the
+    // first directional derivatives along u and v in the `adjoint1` and `adjoint2` attributes and
+    // the second derivative u^T H v in `adjoint12`, exactly and in a single propagation.
+    struct HyperDual {
+        constexpr HyperDual() : m_primal{0.}, m_adjoint1{0.}, m_adjoint2{0.}, m_adjoint12{0.} {}
+        constexpr HyperDual(double primal) : m_primal{primal}, m_adjoint1{0.}, m_adjoint2{0.}, m_adjoint12{0.} {}
+        constexpr HyperDual(double primal, double adjoint1, double adjoint2, double adjoint12=0.)
+            : m_primal{primal}, m_adjoint1{adjoint1}, m_adjoint2{adjoint2}, m_adjoint12{adjoint12} {}
+
+        constexpr double get_primal() const { return this->m_primal; }
+        void set_primal(double val) { this->m_primal = val; }
+
+        constexpr double get_adjoint1() const { return this->m_adjoint1; }
+        void set_adjoint1(double val) { this->m_adjoint1 = val; }
+
+        constexpr double get_adjoint2() const { return this->m_adjoint2; }
+        void set_adjoint2(double val) { this->m_adjoint2 = val; }
+
+        constexpr double get_adjoint12() const { return this->m_adjoint12; }
+        void set_adjoint12(double val) { this->m_adjoint12 = val; }
+
+        const HyperDual& operator=(double x);
+        const HyperDual& operator+=(const HyperDual& d);
+
+        HyperDual operator+(const HyperDual& d) const;
+        HyperDual operator-(const HyperDual& d) const;
+        HyperDual operator*(const HyperDual& d) const;
+        HyperDual operator/(const HyperDual& d) const;
+
+        friend HyperDual sin(const HyperDual& d);
+        friend HyperDual cos(const HyperDual& d);
+        friend HyperDual exp(const HyperDual& d);
+        friend HyperDual log(const HyperDual& d);
+        friend HyperDual abs(const HyperDual& d);
+        friend HyperDual power(const HyperDual& d, double pow);
+        friend HyperDual sqrt(const HyperDual& d);
+
+        friend std::ostream& operator<<(std::ostream& os, const HyperDual& d) {
+            os << "nabla::HyperDual[primal: " << d.m_primal << ", adjoint1: " << d.m_adjoint1
+               << ", adjoint2: " << d.m_adjoint2 << ", adjoint12: " << d.m_adjoint12 << "]";
+            return os;
+        }
+
+    private:
+        // Apply an elementary function with value `f0`, first derivative `f1` and second
+        // derivative `f2` evaluated at this number's primal.
+        HyperDual chain_(double f0, double f1, double f2) const;
+
+        double m_primal;
+        double m_adjoint1;
+        double m_adjoint2;
+        double m_adjoint12;
+    };
+}
+
+#endif
@@ -0,0 +1,766 @@
+// Test entry point (`make test`, or ctest on a CMake build): focused checks of the library,
+// each comparing against a serial or naive reference. Failed checks are printed and make the
+// program exit with EXIT_FAILURE.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nabla.h"
+#include "tensor_aops.hpp"
+
+namespace {
+    int failures = 0;
+
+#define NABLA_CHECK(cond)                                                                  \
+    do {                                                                                   \
+        if (!(cond)) {                                                                     \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond << std::endl; \
+            ++failures;                                                                    \
+        }                                                                                  \
+    } while (0)
+
+    // Whether `fn()` throws an exception of type `E`
+    template<typename E>
+    bool throws(const std::function<void()>& fn) {
+        try {
+            fn();
+        } catch (const E&) {
+            return true;
+        } catch (...) {
+            return false;
+        }
+        return false;
+    }
+
+    std::string temp_path(const std::string& name) {
+        return (std::filesystem::temp_directory_path() / name).string();
+    }
+
+    // y = x_0, then y = y sin(x_i) + exp(x_i / n) for i in [1, n), recorded on the active tape
+    nabla::Var record_chain(const std::vector<nabla::Var>& x) {
+        nabla::Var y = x[0];
+        for (size_t i = 1; i < x.size(); ++i) y = y * sin(x[i]) + exp(x[i] / nabla::Var(double(x.size())));
+        return y;
+    }
+
+    // Spilled tape files swept from disk match the in-memory sweep, and corrupted files are
+    // rejected instead of being swept
+    void test_tape_file() {
+        std::vector<double> expected;
+        std::vector<nabla::node_index_t> inputs;
+        {
+            nabla::GradientTape tape;
+            nabla::GradientTapeScope scope(tape);
+            std::vector<nabla::Var> x;
+            for (size_t i = 0; i < 40; ++i) x.emplace_back(0.1 * double(i) + 0.3);
+            for (const nabla::Var& v : x) inputs.push_back(v.node_gradtape_index);
+            expected = record_chain(x).backward();
+        }
+
+        std::string path = temp_path("nabla_main_test_tape.bin");
+        size_t nodes = 0;
+        {
+            nabla::GradientTape tape;
+            nabla::GradientTapeScope scope(tape);
+            tape.spill_to(path, 7);
+            std::vector<nabla::Var> x;
+            for (size_t i = 0; i < 40; ++i) x.emplace_back(0.1 * double(i) + 0.3);
+            record_chain(x);
+            nodes = tape.finish_spill();
+        }
+        NABLA_CHECK(nodes == expected.size());
+        std::vector<double> adjoints = nabla::backward_from_file(path);
+        NABLA_CHECK(adjoints.size() == expected.size());
+        for (nabla::node_index_t i : inputs) NABLA_CHECK(adjoints.at(i) == expected.at(i));
+
+        auto patch = [&](size_t offset, const void* bytes, size_t size) {
+            std::FILE* file = std::fopen(path.c_str(), "r+b");
+            std::fseek(file, long(offset), SEEK_SET);
+            std::fwrite(bytes, size, 1, file);
+            std::fclose(file);
+        };
+        size_t record = sizeof(nabla::TapeFileHeader) + (nodes / 2) * sizeof(nabla::TapeFileRecord);
+
+        // a parent after its node, then a negative parent
+        nabla::node_index_t bad = nabla::node_index_t(nodes) + 1000;
+        patch(record + offsetof(nabla::TapeFileRecord, parent0), &bad, sizeof(bad));
+        NABLA_CHECK(throws<std::runtime_error>([&] { nabla::backward_from_file(path); }));
+        nabla::node_index_t good = 0;
+        patch(record + offsetof(nabla::TapeFileRecord, parent0), &good, sizeof(good));
+        NABLA_CHECK(nabla::backward_from_file(path).size() == nodes);
+        bad = -5;
+        patch(record + offsetof(nabla::TapeFileRecord, parent1), &bad, sizeof(bad));
+        NABLA_CHECK(throws<std::runtime_error>([&] { nabla::backward_from_file(path); }));
+
+        // more nodes announced than held by the file, including an overflowing count
+        uint64_t count = nodes + 1;
+        patch(offsetof(nabla::TapeFileHeader, node_count), &count, sizeof(count));
+        NABLA_CHECK(throws<std::runtime_error>([&] { nabla::backward_from_file(path); }));
+        count = uint64_t(1) << 62;
+        patch(offsetof(nabla::TapeFileHeader, node_count), &count, sizeof(count));
+        NABLA_CHECK(throws<std::runtime_error>([&] { nabla::backward_from_file(path); }));
+        std::filesystem::resize_file(path, 4);
+        NABLA_CHECK(throws<std::runtime_error>([&] { nabla::backward_from_file(path); }));
+
+        std::remove(path.c_str());
+    }
+
+    // Tape with dependency levels wider than `parallel_level_width`: n products of neighbouring
+    // inputs summed by a pairwise tree. Returns the root; `nodes` gets a few inner nodes.
+    nabla::Var record_wide(size_t n, std::vector<nabla::Var>& x, std::vector<nabla::Var>& nodes) {
+        x.clear();
+        for (size_t i = 0; i < n; ++i) x.emplace_back(std::sin(0.37 * double(i)) + 0.1);
+        std::vector<nabla::Var> level;
+        for (size_t i = 0; i < n; ++i) level.push_back(sin(x[i]) * x[(i + 1) % n] + exp(x[i] * nabla::Var(0.01)));
+        nodes = { level[n / 3], level[n / 2] };
+        while (level.size() > 1) {
+            std::vector<nabla::Var> next;
+            for (size_t i = 0; i + 1 < level.size(); i += 2) next.push_back(level[i] * nabla::Var(0.5) + level[i + 1]);
+            if (level.size() % 2 == 1) next.push_back(level.back());
+            level.swap(next);
+            if (level.size() == 5) nodes.push_back(level[2]);
+        }
+        return level[0];
+    }
+
+    template<typename T>
+    T rosenbrock(const std::vector<T>& x) {
+        T sum = x.at(0) * T(0.);
+        for (size_t i = 0; i + 1 < x.size(); ++i) {
+            T d = x[i + 1] - x[i] * x[i];
+            sum = sum + T(100.) * d * d + (T(1.) - x[i]) * (T(1.) - x[i]);
+        }
+        return sum;
+    }
+
+    // An arena tape never reallocates, throws past its node budget and stays an arena across
+    // clean()
+    void test_arena_tape() {
+        nabla::GradientTape tape(16);
+        nabla::GradientTapeScope scope(tape);
+        for (int repeat = 0; repeat < 2; ++repeat) {
+            NABLA_CHECK(tape.node_budget() == 16 && tape.capacity() >= 16 && tape.size() == 0);
+            const size_t capacity = tape.capacity();
+            std::vector<nabla::Var> x;
+            for (size_t i = 0; i < 16; ++i) x.emplace_back(double(i));
+            NABLA_CHECK(tape.size() == 16 && tape.capacity() == capacity);
+            NABLA_CHECK(throws<std::length_error>([&] { nabla::Var(1.); }));
+            nabla::GradientTape::clean();
+            NABLA_CHECK(tape.capacity() == capacity);
+        }
+    }
+
+    // Reverse-mode gradients match forward mode, leave the tape as they found it (also when f
+    // throws) and can be nested
+    void test_grad_reverse() {
+        std::vector<double> x = { 0.3, -1.2, 0.8, 2.0, -0.5 };
+        std::vector<double> expected = nabla::grad_forward(rosenbrock<nabla::Dual>)(x);
+
+        nabla::GradientTape& tape = nabla::GradientTape::instance();
+        size_t size = tape.size();
+        nabla::Gradient gradient;
+        for (int repeat = 0; repeat < 2; ++repeat) {
+            nabla::grad(rosenbrock<nabla::Var>, x, gradient);
+            NABLA_CHECK(gradient.size() == x.size());
+            for (size_t i = 0; i < x.size(); ++i) NABLA_CHECK(std::abs(gradient[i] - expected[i]) < 1e-9);
+        }
+        NABLA_CHECK(nabla::grad(rosenbrock<nabla::Var>)(x) == gradient);
+        NABLA_CHECK(tape.size() == size);
+
+        auto failing = [](const nabla::VarVec& v) -> nabla::Var {
+            nabla::Var y = v[0] * v[1];
+            throw std::domain_error("f failed");
+            return y;
+        };
+        NABLA_CHECK(throws<std::domain_error>([&] { nabla::grad(failing, x, gradient); }));
+        NABLA_CHECK(tape.size() == size);
+
+        // the gradient of f itself calls grad: its buffers must not be clobbered
+        auto nested = [&](const nabla::VarVec& v) -> nabla::Var {
+            nabla::Gradient inner;
+            nabla::grad(rosenbrock<nabla::Var>, x, inner);
+            return rosenbrock(v) * nabla::Var(std::abs(inner[0] - expected[0]) < 1e-9 ? 2. : 0.);
+        };
+        nabla::grad(nested, x, gradient);
+        for (size_t i = 0; i < x.size(); ++i) NABLA_CHECK(std::abs(gradient[i] - 2. * expected[i]) < 1e-9);
+        NABLA_CHECK(tape.size() == size);
+    }
+
+    // R^6 -> R^2, few outputs so that `jacobian()` picks reverse mode
+    template<typename T>
+    std::vector<T> two_outputs(const std::vector<T>& x) {
+        T s = x[0] * T(0.), p = x[0];
+        for (size_t i = 0; i < x.size(); ++i) s = s + sin(x[i]) * x[(i + 1) % x.size()];
+        for (size_t i = 1; i < x.size(); ++i) p = p * exp(x[i] / T(4.));
+        return { s, p };
+    }
+
+    // Reverse-mode Jacobians match forward mode and the tape is rewound even if G throws
+    void test_jacobian_reverse() {
+        std::vector<double> x = { 0.1, 0.7, -0.4, 1.3, 0.2, -0.9 };
+        nabla::ADMode mode = nabla::ADMode::forward;
+        auto J = nabla::jacobian(two_outputs<nabla::Dual>, two_outputs<nabla::Var>,
+                                 [&](const nabla::JacobianMode& jm) { mode = jm.mode; })(x);
+        NABLA_CHECK(mode == nabla::ADMode::reverse);
+        for (size_t j = 0; j < x.size(); ++j) {
+            nabla::DualVec dual(x.begin(), x.end());
+            dual[j].set_adjoint(1.);
+            nabla::DualVec y = two_outputs(dual);
+            for (size_t i = 0; i < 2; ++i) NABLA_CHECK(std::abs(J[i][j] - y[i].get_adjoint()) < 1e-12);
+        }
+
+        nabla::GradientTape& tape = nabla::GradientTape::instance();
+        size_t size = tape.size();
+        auto failing = [](const nabla::VarVec& v) -> nabla::VarVec {
+            two_outputs(v);
+            throw std::domain_error("G failed");
+        };
+        NABLA_CHECK(throws<std::domain_error>([&] { nabla::jacobian(two_outputs<nabla::Dual>, failing)(x); }));
+        NABLA_CHECK(tape.size() == size);
+    }
+
+    // Banded hessian (tridiagonal) on top of a chain of nonlinear couplings, including powers
+    template<typename T>
+    T banded(const std::vector<T>& x) {
+        T sum = x[0] * x[0];
+        for (size_t i = 0; i + 1 < x.size(); ++i) {
+            T d = x[i + 1] - x[i] * x[i];
+            sum = sum + d * d + sin(x[i]) * exp(x[i + 1]) + power(x[i] * x[i + 1] + T(2.), 1.5);
+        }
+        return sum;
+    }
+
+    // Sparse hessians computed by forward-over-reverse AD of f match the dense forward-mode
+    // hessian, and drop their recordings from the tape
+    void test_sparse_hessian() {
+        std::vector<double> x = { 0.4, -0.3, 1.1, 0.6, -0.8, 0.2, 0.9 };
+        nabla::SparseMatrix pattern = nabla::hessian_sparsity(banded<nabla::SparsityTracer>, x);
+        nabla::Hessian dense = nabla::hessian_forward(banded<nabla::HyperDual>)(x);
+
+        nabla::GradientTape& tape = nabla::GradientTape::instance();
+        size_t size = tape.size();
+        nabla::SparseMatrix H = nabla::sparse_hessian(banded<nabla::HessianVar>, pattern)(x);
+        NABLA_CHECK(tape.size() == size);
+        NABLA_CHECK(H.nnz() == pattern.nnz() && H.values.size() == pattern.nnz());
+
+        size_t nonzeros = 0;
+        for (size_t i = 0; i < x.size(); ++i)
+            for (size_t j = 0; j < x.size(); ++j) nonzeros += dense[i][j] != 0.;
+        NABLA_CHECK(H.nnz() == nonzeros);
+        for (size_t r = 0; r < H.rows; ++r)
+            for (size_t k = H.row_ptr[r]; k < H.row_ptr[r + 1]; ++k)
+                NABLA_CHECK(std::abs(H.values[k] - dense[r][H.col_index[k]]) < 1e-9);
+    }
+
+    // add/sub/mul/div are recorded on the computation graph, and their operators' backward
+    // passes reduce broadcast gradients back to the input shapes (e.g. a bias add)
+    void test_binary_operators() {
+        nabla::Tensor a = nabla::Tensor::rand({3, 4});
+        nabla::Tensor b = nabla::Tensor::rand({1, 4}).apply_transform([](double x) { return x + 1.; });
+        nabla::Tensor grad = nabla::Tensor::rand({3, 4});
+
+        size_t size = nabla::autograd::ComputationGraph<double>::size();
+        nabla::Tensor d = nabla::div(a, b);
+        nabla::sub(a, b);
+        nabla::mul(a, b);
+        NABLA_CHECK(nabla::autograd::ComputationGraph<double>::size() == size + 3);
+        NABLA_CHECK(nabla::autograd::ComputationGraph<double>::get_operator(size).tensor_op.name == "tensor_div_0");
+
+        auto sub_grads = nabla::sub_backward(grad, a, b);
+        auto mul_grads = nabla::mul_backward(grad, a, b);
+        auto div_grads = nabla::div_backward(grad, a, b);
+        NABLA_CHECK(sub_grads.first.shape() == a.shape() && sub_grads.second.shape() == b.shape());
+        for (size_t j = 0; j < 4; ++j) {
+            double bj = b.at({0, j}), neg = 0., prod = 0., quot = 0.;
+            for (size_t i = 0; i < 3; ++i) {
+                double g = grad.at({i, j}), ai = a.at({i, j});
+                NABLA_CHECK(std::abs(d.at({i, j}) - ai / bj) < 1e-12);
+                NABLA_CHECK(sub_grads.first.at({i, j}) == g);
+                NABLA_CHECK(std::abs(mul_grads.first.at({i, j}) - g * bj) < 1e-12);
+                NABLA_CHECK(std::abs(div_grads.first.at({i, j}) - g / bj) < 1e-12);
+                neg -= g;
+                prod += g * ai;
+                quot -= g * ai / (bj * bj);
+            }
+            NABLA_CHECK(std::abs(sub_grads.second.at({0, j}) - neg) < 1e-12);
+            NABLA_CHECK(std::abs(mul_grads.second.at({0, j}) - prod) < 1e-12);
+            NABLA_CHECK(std::abs(div_grads.second.at({0, j}) - quot) < 1e-12);
+        }
+
+        // bias add: [m, n] + [n]
+        nabla::Tensor bias = nabla::Tensor::rand({4});
+        nabla::Tensor sum = nabla::add(a, bias);
+        NABLA_CHECK(nabla::autograd::ComputationGraph<double>::get_operator(size + 3).tensor_op.name == "tensor_add_0");
+        auto add_grads = nabla::add_backward(grad, a, bias);
+        NABLA_CHECK(add_grads.first.shape() == a.shape());
+        NABLA_CHECK(add_grads.second.shape() == std::vector<size_t>{ 4 });
+        for (size_t j = 0; j < 4; ++j) {
+            double total = 0.;
+            for (size_t i = 0; i < 3; ++i) {
+                NABLA_CHECK(sum.at({i, j}) == a.at({i, j}) + bias.data()[j]);
+                NABLA_CHECK(add_grads.first.at({i, j}) == grad.at({i, j}));
+                total += grad.at({i, j});
+            }
+            NABLA_CHECK(std::abs(add_grads.second.data()[j] - total) < 1e-12);
+        }
+
+        // backward passes do not record anything
+        NABLA_CHECK(nabla::autograd::ComputationGraph<double>::size() == size + 4);
+    }
+
+    // Float elementwise arithmetic runs on the vectorized binary kernels and matches the scalar
+    // float operators exactly, on contiguous and broadcast operands of lengths that are not a
+    // multiple of the vector width
+    void test_float_binary_kernels() {
+        for (size_t n : { size_t(1), size_t(7), size_t(8), size_t(29), size_t(1000) }) {
+            std::vector<float> x(n), y(n), o(n);
+            for (size_t i = 0; i < n; ++i) {
+                x[i] = 0.37f * float(i) - 3.1f;
+                y[i] = 1.3f + 0.011f * float(i * i % 97);
+            }
+            const nabla::kernels::BinaryFn fns[] = { nabla::kernels::BinaryFn::add, nabla::kernels::BinaryFn::sub,
+                                                     nabla::kernels::BinaryFn::mul, nabla::kernels::BinaryFn::div };
+            auto scalar = [](nabla::kernels::BinaryFn fn, float a, float b) {
+                switch (fn) {
+                    case nabla::kernels::BinaryFn::add: return a + b;
+                    case nabla::kernels::BinaryFn::sub: return a - b;
+                    case nabla::kernels::BinaryFn::mul: return a * b;
+                    case nabla::kernels::BinaryFn::div: return a / b;
+                }
+                return 0.f;
+            };
+            for (nabla::kernels::BinaryFn fn : fns) {
+                for (size_t xs : { size_t(0), size_t(1) }) {
+                    for (size_t ys : { size_t(0), size_t(1) }) {
+                        nabla::kernels::binary_run(fn, x.data(), xs, y.data(), ys, o.data(), n);
+                        for (size_t i = 0; i < n; ++i) NABLA_CHECK(o[i] == scalar(fn, x[i * xs], y[i * ys]));
+                    }
+                }
+            }
+        }
+    }
+
+    // The level-scheduled parallel sweep matches the sequential sweep: bitwise in deterministic
+    // mode, up to rounding with atomic scatters
+    void test_backward_parallel() {
+        nabla::GradientTape tape;
+        nabla::GradientTapeScope scope(tape);
+        std::vector<nabla::Var> x, nodes;
+        nabla::Var y = record_wide(20000, x, nodes);
+
+        std::vector<double> expected, adjoints;
+        tape.backward(y.node_gradtape_index, expected);
+        for (size_t num_threads : { size_t(1), size_t(3), size_t(4) }) {
+            tape.backward_parallel(y.node_gradtape_index, adjoints, num_threads, true);
+            NABLA_CHECK(adjoints == expected);
+
+            tape.backward_parallel(y.node_gradtape_index, adjoints, num_threads, false);
+            NABLA_CHECK(adjoints.size() == expected.size());
+            for (size_t i = 0; i < expected.size(); ++i)
+                NABLA_CHECK(std::abs(adjoints[i] - expected[i]) <= 1e-12 * (1. + std::abs(expected[i])));
+        }
+
+        // from an inner output, nodes recorded after it get a zero adjoint
+        tape.backward(nodes.back().node_gradtape_index, expected);
+        tape.backward_parallel(nodes.back().node_gradtape_index, adjoints, 4, true);
+        NABLA_CHECK(adjoints == expected);
+    }
+
+    // A vector-mode sweep carrying k adjoints per node matches k separate scalar sweeps, and
+    // the seeded (vector-jacobian product) sweep matches their weighted sum
+    void test_backward_vector() {
+        nabla::GradientTape tape;
+        nabla::GradientTapeScope scope(tape);
+        std::vector<nabla::Var> x, nodes;
+        nabla::Var y = record_wide(3000, x, nodes);
+
+        std::vector<nabla::node_index_t> outputs = { y.node_gradtape_index };
+        for (const nabla::Var& v : nodes) outputs.push_back(v.node_gradtape_index);
+        outputs.push_back(x[7].node_gradtape_index); // a leaf as output
+        const size_t k = outputs.size();
+
+        std::vector<double> lanes;
+        tape.backward_vector(outputs, lanes);
+        NABLA_CHECK(lanes.size() == tape.size() * k);
+
+        std::vector<double> seeds(k);
+        for (size_t j = 0; j < k; ++j) seeds[j] = 1.5 - double(j);
+        std::vector<double> vjp, combined(tape.size(), 0.), adjoints;
+        tape.backward(outputs, seeds, vjp);
+        for (size_t j = 0; j < k; ++j) {
+            tape.backward(outputs[j], adjoints);
+            for (size_t i = 0; i < tape.size(); ++i) {
+                NABLA_CHECK(lanes[i * k + j] == adjoints[i]);
+                combined[i] += seeds[j] * adjoints[i];
+            }
+        }
+        NABLA_CHECK(vjp.size() == tape.size());
+        for (size_t i = 0; i < tape.size(); ++i)
+            NABLA_CHECK(std::abs(vjp[i] - combined[i]) <= 1e-12 * (1. + std::abs(combined[i])));
+
+        tape.backward_vector({}, lanes);
+        NABLA_CHECK(lanes.empty());
+    }
+
+    // GEMM against a naive triple loop accumulated in long double, on shapes that leave partial
+    // micro-kernel tiles and cross the mc/kc cache blocks, with transposed operands, a padded C,
+    // accumulation and several threads
+    template<typename T>
+    void check_gemm(size_t m, size_t n, size_t k, bool transpose_a, bool transpose_b, bool accumulate,
+                    size_t num_threads, double tolerance) {
+        std::vector<T> a(m * k), b(k * n);
+        for (size_t i = 0; i < a.size(); ++i) a[i] = T(std::sin(0.7 * double(i) + 0.2));
+        for (size_t i = 0; i < b.size(); ++i) b[i] = T(std::cos(0.3 * double(i) - 1.1));
+        // A is m x k, stored row-major or as the transpose of a row-major k x m matrix
+        size_t a_rs = transpose_a ? 1 : k, a_cs = transpose_a ? m : 1;
+        size_t b_rs = transpose_b ? 1 : n, b_cs = transpose_b ? k : 1;
+        size_t ldc = n + 3;
+        std::vector<T> c(m * ldc, T(-7));
+        for (size_t i = 0; i < m; ++i)
+            for (size_t j = 0; j < n; ++j) c[i * ldc + j] = T(0.25 * double(i) - 0.5 * double(j));
+        std::vector<T> c0 = c;
+
+        nabla::kernels::gemm(m, n, k, a.data(), a_rs, a_cs, b.data(), b_rs, b_cs, c.data(), ldc, accumulate,
+                             num_threads);
+        for (size_t i = 0; i < m; ++i) {
+            for (size_t j = 0; j < ldc; ++j) {
+                if (j >= n) {
+                    NABLA_CHECK(c[i * ldc + j] == T(-7)); // padding is left untouched
+                    continue;
+                }
+                long double expected = accumulate ? c0[i * ldc + j] : 0;
+                long double magnitude = std::abs(expected);
+                for (size_t p = 0; p < k; ++p) {
+                    long double term = (long double)a[i * a_rs + p * a_cs] * b[p * b_rs + j * b_cs];
+                    expected += term;
+                    magnitude += std::abs(term);
+                }
+                NABLA_CHECK(std::abs(c[i * ldc + j] - expected) <= tolerance * (1 + magnitude));
+            }
+        }
+    }
+
+    void test_gemm_edges() {
+        const size_t shapes[][3] = { { 1, 1, 1 }, { 5, 7, 3 }, { 6, 8, 4 }, { 13, 17, 300 }, { 97, 9, 11 },
+                                     { 7, 19, 0 }, { 12, 16, 257 }, { 101, 33, 513 } };
+        for (const auto& shape : shapes) {
+            for (int variant = 0; variant < 8; ++variant) {
+                bool ta = variant & 1, tb = variant & 2, acc = variant & 4;
+                check_gemm<double>(shape[0], shape[1], shape[2], ta, tb, acc, 1, 1e-14);
+                check_gemm<float>(shape[0], shape[1], shape[2], ta, tb, acc, 1, 1e-6);
+            }
+        }
+        check_gemm<double>(131, 141, 300, true, false, true, 4, 1e-14);
+        check_gemm<float>(131, 141, 300, false, true, false, 4, 1e-6);
+
+        // batched matmul of a transposed view broadcast against a batch
+        nabla::Tensor a = nabla::Tensor::rand({7, 5});
+        nabla::Tensor b = nabla::Tensor::rand({3, 7, 4});
+        nabla::Tensor c = nabla::batched_matmul(a.t(), b);
+        NABLA_CHECK((c.shape() == std::vector<size_t>{ 3, 5, 4 }));
+        for (size_t q = 0; q < 3; ++q)
+            for (size_t i = 0; i < 5; ++i)
+                for (size_t j = 0; j < 4; ++j) {
+                    double expected = 0.;
+                    for (size_t p = 0; p < 7; ++p) expected += a.at({p, i}) * b.at({q, p, j});
+                    NABLA_CHECK(std::abs(c.at({q, i, j}) - expected) < 1e-12);
+                }
+    }
+
+    // Reduce a 3-d tensor over `axes` naively: `fn` gets the reduced elements of each output in
+    // row-major order, outputs are returned in row-major order of the kept dimensions
+    template<typename F>
+    std::vector<double> naive_reduce(const nabla::Tensor& x, const std::vector<size_t>& axes, F fn) {
+        const std::vector<size_t>& shape = x.shape();
+        auto reduced = [&](size_t d) { return axes.empty() || std::find(axes.begin(), axes.end(), d) != axes.end(); };
+        size_t outputs = 1;
+        for (size_t d = 0; d < 3; ++d) outputs *= reduced(d) ? 1 : shape[d];
+        std::vector<std::vector<double>> groups(outputs);
+        for (size_t i = 0; i < shape[0]; ++i)
+            for (size_t j = 0; j < shape[1]; ++j)
+                for (size_t k = 0; k < shape[2]; ++k) {
+                    size_t index[3] = { i, j, k }, out = 0;
+                    for (size_t d = 0; d < 3; ++d)
+                        if (!reduced(d)) out = out * shape[d] + index[d];
+                    groups[out].push_back(x.at({ i, j, k }));
+                }
+        std::vector<double> result;
+        for (const std::vector<double>& group : groups) result.push_back(fn(group));
+        return result;
+    }
+
+    // Index of the first maximum, or of the first NaN
+    size_t naive_argmax(const std::vector<double>& v) {
+        size_t best = 0;
+        for (size_t i = 0; i < v.size(); ++i) {
+            if (std::isnan(v[i])) return i;
+            if (v[i] > v[best]) best = i;
+        }
+        return best;
+    }
+
+    bool close_to(const nabla::Tensor& t, const std::vector<double>& expected) {
+        nabla::Tensor c = t.contiguous();
+        if (c.size() != expected.size()) return false;
+        for (size_t i = 0; i < expected.size(); ++i) {
+            if (std::isnan(expected[i]) != std::isnan(c.data()[i])) return false;
+            if (!std::isnan(expected[i]) && std::abs(c.data()[i] - expected[i]) > 1e-12 * (1. + std::abs(expected[i])))
+                return false;
+        }
+        return true;
+    }
+
+    // Reductions over every set of axes, with and without keepdim, on contiguous tensors and
+    // transposed views, match a naive reference; max/argmax keep the first of tied maxima and
+    // propagate NaN, and float argmax indices are exact past 2^24; each differentiable reduction
+    // records one graph node
+    void test_reductions() {
+        nabla::Tensor base({ 4, 5, 6 });
+        for (size_t i = 0; i < base.size(); ++i) base.data()[i] = std::sin(0.37 * double(i)) * 3.;
+        base.at({ 2, 1, 0 }) = 5.;
+        base.at({ 2, 3, 0 }) = 5.; // tied maxima
+
+        auto sum = [](const std::vector<double>& v) { double s = 0.; for (double x : v) s += x; return s; };
+        auto max = [](const std::vector<double>& v) { return v[naive_argmax(v)]; };
+        auto lse = [&](const std::vector<double>& v) {
+            double m = max(v), s = 0.;
+            for (double x : v) s += std::exp(x - m);
+            return m + std::log(s);
+        };
+        auto norm = [](const std::vector<double>& v) { double s = 0.; for (double x : v) s += x * x; return std::sqrt(s); };
+
+        const std::vector<std::vector<size_t>> axes_sets = { {}, { 0 }, { 1 }, { 2 }, { 0, 2 }, { 2, 1 }, { 0, 1, 2 } };
+        for (const nabla::Tensor& x : { base, base.permute({ 2, 0, 1 }), base.transpose(0, 1) }) {
+            for (const std::vector<size_t>& axes : axes_sets) {
+                for (bool keepdim : { false, true }) {
+                    std::vector<size_t> shape = nabla::reduced_shape(x.shape(), axes, keepdim);
+                    nabla::Tensor s = nabla::sum(x, axes, keepdim);
+                    NABLA_CHECK(s.shape() == shape);
+                    NABLA_CHECK(close_to(s, naive_reduce(x, axes, sum)));
+                    NABLA_CHECK(close_to(nabla::mean(x, axes, keepdim),
+                                         naive_reduce(x, axes, [&](const std::vector<double>& v) { return sum(v) / double(v.size()); })));
+                    NABLA_CHECK(close_to(nabla::max(x, axes, keepdim), naive_reduce(x, axes, max)));
+                    NABLA_CHECK(close_to(nabla::argmax(x, axes, keepdim),
+                                         naive_reduce(x, axes, [](const std::vector<double>& v) { return double(naive_argmax(v)); })));
+                    NABLA_CHECK(close_to(nabla::logsumexp(x, axes, keepdim), naive_reduce(x, axes, lse)));
+                    NABLA_CHECK(close_to(nabla::norm(x, axes, keepdim), naive_reduce(x, axes, norm)));
+                }
+            }
+        }
+
+        // the gradient of a tied maximum is split between the tied elements
+        nabla::Tensor grad = nabla::max_backward(nabla::Tensor::ones({}), base);
+        NABLA_CHECK(grad.at({ 2, 1, 0 }) == 0.5 && grad.at({ 2, 3, 0 }) == 0.5);
+        NABLA_CHECK(close_to(nabla::sum(grad), { 1. }));
+
+        nabla::Tensor with_nan = base.contiguous();
+        with_nan.at({ 1, 2, 3 }) = std::nan("");
+        with_nan.at({ 1, 4, 3 }) = std::nan("");
+        for (const std::vector<size_t>& axes : axes_sets) {
+            NABLA_CHECK(close_to(nabla::max(with_nan, axes), naive_reduce(with_nan, axes, max)));
+            NABLA_CHECK(close_to(nabla::argmax(with_nan, axes),
+                                 naive_reduce(with_nan, axes, [](const std::vector<double>& v) { return double(naive_argmax(v)); })));
+        }
+
+        // float argmax indices beyond 2^24 are exact
+        nabla::FloatTensor large({ (size_t(1) << 24) + 3 });
+        std::fill(large.data(), large.data() + large.size(), 0.f);
+        large.data()[(size_t(1) << 24) + 1] = 1.f;
+        NABLA_CHECK(nabla::argmax(large).data()[0] == double((size_t(1) << 24) + 1));
+        NABLA_CHECK(nabla::argmax(large.reshape({ large.size(), 1 }), { 0 }).data()[0] == double((size_t(1) << 24) + 1));
+        NABLA_CHECK(throws<std::invalid_argument>([&] { nabla::reduce(large, nabla::kernels::ReduceOp::argmax, {}); }));
+
+        size_t size = nabla::autograd::ComputationGraph<double>::size();
+        nabla::sum(base, { 1 });
+        nabla::mean(base);
+        nabla::max(base, { 0, 2 }, true);
+        nabla::logsumexp(base, { 2 });
+        nabla::norm(base);
+        nabla::argmax(base);
+        nabla::logsumexp_backward(nabla::Tensor::ones({ 4, 5 }), base, { 2 });
+        NABLA_CHECK(nabla::autograd::ComputationGraph<double>::size() == size + 5);
+    }
+
+    // Allocator forwarding to the system allocator and counting the calls
+    struct CountingAllocator : nabla::memory::Allocator {
+        void* allocate(size_t bytes) override {
+            ++allocations;
+            return nabla::memory::system_allocator().allocate(bytes);
+        }
+        void deallocate(void* p, size_t bytes) noexcept override {
+            ++deallocations;
+            nabla::memory::system_allocator().deallocate(p, bytes);
+        }
+        nabla::memory::AllocatorStats stats() const override { return {}; }
+
+        std::atomic<uint64_t> allocations{0}, deallocations{0};
+    };
+
+    // Caching allocator: aligned buffers, reuse counted as hits, byte accounting, release,
+    // frees from other threads (also outliving the allocator), caching limits and custom
+    // allocators installed with set_allocator()
+    void test_allocator() {
+        namespace memory = nabla::memory;
+        {
+            memory::CachingAllocator allocator;
+            // one size per class
+            for (size_t bytes : { size_t(1), size_t(65), size_t(300), size_t(5000), size_t(1) << 20 }) {
+                void* p = allocator.allocate(bytes);
+                NABLA_CHECK(reinterpret_cast<uintptr_t>(p) % memory::alignment == 0);
+                std::memset(p, 0xab, bytes);
+                allocator.deallocate(p, bytes);
+                void* q = allocator.allocate(bytes); // served from the thread cache
+                NABLA_CHECK(q == p);
+                allocator.deallocate(q, bytes);
+            }
+            memory::AllocatorStats stats = allocator.stats();
+            NABLA_CHECK(stats.allocations == 10 && stats.hits == 5 && stats.deallocations == 10);
+            NABLA_CHECK(stats.bytes_in_use == 0 && stats.bytes_cached > 0);
+
+            // 63 and 64 bytes share the class of 1 byte, 100 bytes the class of 65 (128 bytes)
+            allocator.deallocate(allocator.allocate(63), 63);
+            allocator.deallocate(allocator.allocate(64), 64);
+            void* p = allocator.allocate(100);
+            NABLA_CHECK(allocator.stats().hits == stats.hits + 3);
+            NABLA_CHECK(allocator.stats().bytes_in_use == 128);
+            allocator.deallocate(p, 100);
+
+            allocator.release();
+            NABLA_CHECK(allocator.stats().bytes_cached == 0);
+            uint64_t hits = allocator.stats().hits;
+            allocator.deallocate(allocator.allocate(100), 100);
+            NABLA_CHECK(allocator.stats().hits == hits);
+
+            // a block freed by another thread reaches the shared pool when that thread exits
+            void* shared = allocator.allocate(4096);
+            std::thread([&] { allocator.deallocate(shared, 4096); }).join();
+            NABLA_CHECK(allocator.allocate(4096) == shared);
+            NABLA_CHECK(allocator.stats().hits == hits + 1);
+            allocator.deallocate(shared, 4096);
+        }
+        {
+            // a thread still caching blocks of a destroyed allocator frees them when it exits
+            auto allocator = std::make_unique<memory::CachingAllocator>();
+            void* p = allocator->allocate(256);
+            std::promise<void> freed, destroyed;
+            std::shared_future<void> destroyed_future = destroyed.get_future().share();
+            std::thread thread([&] {
+                allocator->deallocate(p, 256);
+                freed.set_value();
+                destroyed_future.wait();
+            });
+            freed.get_future().wait();
+            allocator.reset();
+            destroyed.set_value();
+            thread.join();
+        }
+        {
+            // nothing cached past the limits: every block goes back to the system
+            memory::CachingAllocator allocator(0, 0);
+            for (int i = 0; i < 3; ++i) allocator.deallocate(allocator.allocate(512), 512);
+            NABLA_CHECK(allocator.stats().hits == 0 && allocator.stats().bytes_cached == 0);
+
+            // the thread cache keeps 128 bytes, the pool the rest
+            memory::CachingAllocator small(1 << 20, 128);
+            void* blocks[3] = { small.allocate(64), small.allocate(64), small.allocate(64) };
+            for (void* b : blocks) small.deallocate(b, 64);
+            NABLA_CHECK(small.stats().bytes_cached == 192);
+            for (void*& b : blocks) b = small.allocate(64);
+            NABLA_CHECK(small.stats().hits == 3 && small.stats().bytes_cached == 0);
+            for (void* b : blocks) small.deallocate(b, 64);
+        }
+        {
+            // tensors are freed by the allocator they were created with
+            CountingAllocator counting;
+            memory::Allocator& previous = memory::get_allocator();
+            memory::set_allocator(counting);
+            nabla::Tensor t({ 16, 16 });
+            memory::set_allocator(previous);
+            NABLA_CHECK(counting.allocations == 1);
+            nabla::Tensor u({ 16, 16 });
+            NABLA_CHECK(counting.allocations == 1);
+            t = nabla::Tensor();
+            NABLA_CHECK(counting.deallocations == 1);
+        }
+    }
+
+    // Explicit Euler step of a pendulum
+    std::vector<nabla::Var> pendulum_step(const std::vector<nabla::Var>& x) {
+        nabla::Var h(1e-3);
+        return { x[0] + h * x[1], x[1] - h * sin(x[0]) };
+    }
+
+    nabla::Var pendulum_loss(const std::vector<nabla::Var>& x) { return x[0] * x[0] + x[1]; }
+
+    // Checkpointed gradients match the gradient of the fully recorded loop for any snapshot
+    // budget, including budgets in the tens of thousands, within the expected step counts
+    void test_checkpointing() {
+        std::vector<double> x0 = { 0.8, -0.3 };
+        for (size_t steps : { size_t(1), size_t(2), size_t(17), size_t(20000) }) {
+            auto unrolled = [steps](const nabla::VarVec& x) {
+                nabla::VarVec state = x;
+                for (size_t k = 0; k < steps; ++k) state = pendulum_step(state);
+                return pendulum_loss(state);
+            };
+            nabla::Gradient expected = nabla::grad(unrolled)(x0);
+
+            for (size_t snapshots : { size_t(0), size_t(1), size_t(3), size_t(10000), size_t(1) << 20 }) {
+                if (steps > 100 && snapshots < 3) continue; // quadratic recomputation
+                nabla::GradientTape& tape = nabla::GradientTape::instance();
+                size_t size = tape.size();
+                nabla::CheckpointResult result =
+                    nabla::checkpointed_gradient(pendulum_step, pendulum_loss, x0, steps, snapshots);
+                NABLA_CHECK(tape.size() == size);
+                for (size_t i = 0; i < x0.size(); ++i)
+                    NABLA_CHECK(std::abs(result.gradient[i] - expected[i]) <= 1e-10 * (1. + std::abs(expected[i])));
+                NABLA_CHECK(result.stats.recorded_steps == steps);
+                NABLA_CHECK(result.stats.peak_snapshots <= std::min(snapshots, steps - 1) + 1);
+                // enough snapshots for every state: one forward sweep and one recorded sweep
+                if (snapshots >= steps - 1) NABLA_CHECK(result.stats.forward_steps == 2 * steps);
+            }
+        }
+
+        // 10^5 steps with 10^4 snapshots: two recomputations per step
+        nabla::CheckpointResult result =
+            nabla::checkpointed_gradient(pendulum_step, pendulum_loss, x0, 100000, 10000);
+        NABLA_CHECK(result.stats.peak_snapshots <= 10001);
+        NABLA_CHECK(result.stats.forward_steps <= 3 * 100000);
+    }
+} // namespace
+
+int main() {
+    test_tape_file();
+    test_arena_tape();
+    test_grad_reverse();
+    test_jacobian_reverse();
+    test_sparse_hessian();
+    test_binary_operators();
+    test_float_binary_kernels();
+    test_backward_parallel();
+    test_backward_vector();
+    test_gemm_edges();
+    test_reductions();
+    test_allocator();
+    test_checkpointing();
+
+    if (failures > 0) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -3,6 +3,16 @@
 
 #include "core.hpp"
 #include "dual.hpp"
+#include "dual_n.hpp"
+#include "dual_expr.hpp"
+#include "hyper_dual.hpp"
+#include "sparsity.hpp"
 #include "tensor.hpp"
+#include "tensor_lazy.hpp"
+#include "var.hpp"
+#include "taped_function.hpp"
+#include "checkpointing.hpp"
+#include "tape_file.hpp"
+#include "profiler.hpp"
 
 #endif
@@ -0,0 +1,99 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nabla {
+    namespace parallel {
+        // Number of worker threads to use when the caller asks for `0` (i.e. "as many as possible").
+        inline size_t default_num_threads() {
+            size_t n = std::thread::hardware_concurrency();
+            return n == 0 ? 1 : n;
+        }
+
+        // Split the index range [0, n) into chunks of `chunk_size` indices and hand them out
+        // dynamically to `num_threads` workers. `fn(thread_id, begin, end)` is called once per
+        // chunk; `thread_id` is in [0, num_threads) so callers can index per-thread state.
+        // A `num_threads` of 0 uses all hardware threads and a `chunk_size` of 0 picks a chunk
+        // size giving roughly four chunks per thread. The first exception thrown by a worker is
+        // rethrown in the calling thread once all workers have joined.
+        inline void for_chunks(size_t n, size_t num_threads, size_t chunk_size,
+                               const std::function<void(size_t, size_t, size_t)>& fn) {
+            if (n == 0) return;
+            if (num_threads == 0) num_threads = default_num_threads();
+            if (chunk_size == 0) chunk_size = std::max<size_t>(1, n / (4 * num_threads));
+
+            size_t num_chunks = (n + chunk_size - 1) / chunk_size;
+            num_threads = std::min(num_threads, num_chunks);
+
+            if (num_threads <= 1) {
+                for (size_t begin = 0; begin < n; begin += chunk_size)
+                    fn(0, begin, std::min(n, begin + chunk_size));
+                return;
+            }
+
+            std::atomic<size_t> next_chunk{0};
+            std::exception_ptr error;
+            std::mutex error_mutex;
+
+            auto worker = [&](size_t thread_id) {
+                try {
+                    for (size_t c = next_chunk++; c < num_chunks; c = next_chunk++) {
+                        size_t begin = c * chunk_size;
+                        fn(thread_id, begin, std::min(n, begin + chunk_size));
+                    }
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error) error = std::current_exception();
+                    next_chunk = num_chunks; // stop handing out work
+                }
+            };
+
+            std::vector<std::thread> workers;
+            workers.reserve(num_threads - 1);
+            for (size_t t = 1; t < num_threads; ++t) workers.emplace_back(worker, t);
+            worker(0); // the calling thread works too
+            for (auto& w : workers) w.join();
+
+            if (error) std::rethrow_exception(error);
+        }
+
+        // Reusable barrier for a fixed number of threads: `wait()` blocks until `count` threads
+        // have called it, then releases them all and resets for the next round.
+        struct Barrier {
+            explicit Barrier(size_t count) : m_count{count} {}
+
+            Barrier(const Barrier&) = delete;
+            Barrier& operator=(const Barrier&) = delete;
+
+            void wait() {
+                std::unique_lock<std::mutex> lock(this->m_mutex);
+                size_t generation = this->m_generation;
+                if (++this->m_arrived == this->m_count) {
+                    this->m_arrived = 0;
+                    ++this->m_generation;
+                    this->m_released.notify_all();
+                    return;
+                }
+                this->m_released.wait(lock, [&] { return generation != this->m_generation; });
+            }
+
+        private:
+            std::mutex m_mutex;
+            std::condition_variable m_released;
+            size_t m_count;
+            size_t m_arrived = 0;
+            size_t m_generation = 0;
+        };
+    } // namespace parallel
+} // namespace nabla
+
+#endif
@@ -0,0 +1,173 @@
+#include "profiler.hpp"
+
+#include <array>
+#include <atomic>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+namespace nabla {
+    namespace profiler {
+        const char* sweep_name(Sweep sweep) {
+            switch (sweep) {
+                case Sweep::backward: return "backward";
+                case Sweep::backward_vector: return "backward_vector";
+                case Sweep::backward_parallel: return "backward_parallel";
+                case Sweep::backward_from_file: return "backward_from_file";
+            }
+            return "unknown";
+        }
+
+        namespace {
+            // Counters of one thread. Only the owning thread writes them; they are atomics so that
+            // `snapshot()` can read them concurrently.
+            struct ThreadCounters {
+                struct Op {
+                    std::atomic<uint64_t> count{0}, tape_bytes{0}, forward_ns{0}, record_ns{0};
+                };
+                struct Sweep {
+                    std::atomic<uint64_t> count{0}, nodes{0}, backward_ns{0};
+                };
+                std::array<Op, num_op_kinds> ops;
+                std::array<Sweep, num_sweeps> sweeps;
+            };
+
+            // Counters of every thread ever profiled, kept alive past thread exit
+            struct Registry {
+                std::mutex mutex;
+                std::vector<std::shared_ptr<ThreadCounters>> threads;
+            };
+
+            Registry& registry() {
+                static Registry r;
+                return r;
+            }
+
+            ThreadCounters& thread_counters() {
+                thread_local std::shared_ptr<ThreadCounters> counters = [] {
+                    auto c = std::make_shared<ThreadCounters>();
+                    Registry& r = registry();
+                    std::lock_guard<std::mutex> lock(r.mutex);
+                    r.threads.push_back(c);
+                    return c;
+                }();
+                return *counters;
+            }
+
+            void bump(std::atomic<uint64_t>& counter, uint64_t value) {
+                counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+            }
+        } // namespace
+
+        namespace detail {
+            void add_op(OpKind kind, uint64_t forward_ns) {
+                bump(thread_counters().ops[size_t(kind)].forward_ns, forward_ns);
+            }
+
+            void add_record(OpKind kind, uint64_t tape_bytes, uint64_t record_ns) {
+                ThreadCounters::Op& op = thread_counters().ops[size_t(kind)];
+                bump(op.count, 1);
+                bump(op.tape_bytes, tape_bytes);
+                bump(op.record_ns, record_ns);
+            }
+
+            void add_sweep(Sweep sweep, uint64_t nodes, uint64_t backward_ns) {
+                ThreadCounters::Sweep& s = thread_counters().sweeps[size_t(sweep)];
+                bump(s.count, 1);
+                bump(s.nodes, nodes);
+                bump(s.backward_ns, backward_ns);
+            }
+
+            uint64_t record_ns(OpKind kind) {
+                return thread_counters().ops[size_t(kind)].record_ns.load(std::memory_order_relaxed);
+            }
+        } // namespace detail
+
+        Snapshot snapshot() {
+            Snapshot snap;
+            for (size_t k = 0; k < num_op_kinds; ++k) snap.ops.push_back({ OpKind(k) });
+            for (size_t s = 0; s < num_sweeps; ++s) snap.sweeps.push_back({ Sweep(s) });
+
+            Registry& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            for (const auto& thread : r.threads) {
+                for (size_t k = 0; k < num_op_kinds; ++k) {
+                    const ThreadCounters::Op& op = thread->ops[k];
+                    snap.ops[k].count += op.count.load(std::memory_order_relaxed);
+                    snap.ops[k].tape_bytes += op.tape_bytes.load(std::memory_order_relaxed);
+                    snap.ops[k].forward_ns += op.forward_ns.load(std::memory_order_relaxed);
+                    snap.ops[k].record_ns += op.record_ns.load(std::memory_order_relaxed);
+                }
+                for (size_t s = 0; s < num_sweeps; ++s) {
+                    const ThreadCounters::Sweep& sweep = thread->sweeps[s];
+                    snap.sweeps[s].count += sweep.count.load(std::memory_order_relaxed);
+                    snap.sweeps[s].nodes += sweep.nodes.load(std::memory_order_relaxed);
+                    snap.sweeps[s].backward_ns += sweep.backward_ns.load(std::memory_order_relaxed);
+                }
+            }
+            return snap;
+        }
+
+        void reset() {
+            Registry& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            for (const auto& thread : r.threads) {
+                for (auto& op : thread->ops)
+                    for (auto* c : { &op.count, &op.tape_bytes, &op.forward_ns, &op.record_ns }) c->store(0);
+                for (auto& sweep : thread->sweeps)
+                    for (auto* c : { &sweep.count, &sweep.nodes, &sweep.backward_ns }) c->store(0);
+            }
+        }
+
+        static void report_table_(std::ostream& os, const Snapshot& snap) {
+            os << std::left << std::setw(20) << "op" << std::right << std::setw(14) << "count"
+               << std::setw(16) << "tape_bytes" << std::setw(16) << "forward_us" << std::setw(16) << "record_us"
+               << std::endl;
+            for (const OpStats& op : snap.ops) {
+                if (op.count == 0) continue;
+                os << std::left << std::setw(20) << op_kind_name(op.kind) << std::right << std::setw(14) << op.count
+                   << std::setw(16) << op.tape_bytes << std::setw(16) << op.forward_ns / 1000
+                   << std::setw(16) << op.record_ns / 1000 << std::endl;
+            }
+            os << std::left << std::setw(20) << "sweep" << std::right << std::setw(14) << "count"
+               << std::setw(16) << "nodes" << std::setw(16) << "backward_us" << std::endl;
+            for (const SweepStats& sweep : snap.sweeps) {
+                if (sweep.count == 0) continue;
+                os << std::left << std::setw(20) << sweep_name(sweep.sweep) << std::right << std::setw(14)
+                   << sweep.count << std::setw(16) << sweep.nodes << std::setw(16) << sweep.backward_ns / 1000
+                   << std::endl;
+            }
+        }
+
+        static void report_json_(std::ostream& os, const Snapshot& snap) {
+            os << "{\"enabled\": " << (enabled ? "true" : "false") << ", \"ops\": [";
+            const char* sep = "";
+            for (const OpStats& op : snap.ops) {
+                if (op.count == 0) continue;
+                os << sep << "{\"op\": \"" << op_kind_name(op.kind) << "\", \"count\": " << op.count
+                   << ", \"tape_bytes\": " << op.tape_bytes << ", \"forward_ns\": " << op.forward_ns
+                   << ", \"record_ns\": " << op.record_ns << "}";
+                sep = ", ";
+            }
+            os << "], \"sweeps\": [";
+            sep = "";
+            for (const SweepStats& sweep : snap.sweeps) {
+                if (sweep.count == 0) continue;
+                os << sep << "{\"sweep\": \"" << sweep_name(sweep.sweep) << "\", \"count\": " << sweep.count
+                   << ", \"nodes\": " << sweep.nodes << ", \"backward_ns\": " << sweep.backward_ns << "}";
+                sep = ", ";
+            }
+            os << "]}" << std::endl;
+        }
+
+        void report(std::ostream& os, Format format) {
+            Snapshot snap = snapshot();
+            if (format == Format::json) {
+                report_json_(os, snap);
+                return;
+            }
+            if (!enabled) os << "nabla::profiler: built without NABLA_PROFILE, no counters recorded" << std::endl;
+            report_table_(os, snap);
+        }
+    } // namespace profiler
+} // namespace nabla
@@ -0,0 +1,130 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "gradient_tape.hpp"
+
+namespace nabla {
+    // Instrumentation of the reverse-mode hot paths. Compiled in only when NABLA_PROFILE is
+    // defined (e.g. `make PROFILE=1` or `cmake -DNABLA_PROFILE=ON`); otherwise every hook below
+    // is an empty inline object and costs nothing.
+    //
+    // Per op kind it counts how many nodes were recorded, the tape bytes they take, and the time
+    // spent computing the primal values (forward) and appending to the tape (record). Reverse
+    // sweeps do not know the op kind of the nodes they visit in release builds, so backward time
+    // is accounted per sweep flavour together with the number of nodes swept. Counters are kept
+    // per thread and summed by `snapshot()` / `report()`.
+    namespace profiler {
+#ifdef NABLA_PROFILE
+        inline constexpr bool enabled = true;
+#else
+        inline constexpr bool enabled = false;
+#endif
+
+        enum class Sweep : uint8_t { backward, backward_vector, backward_parallel, backward_from_file };
+        constexpr size_t num_op_kinds = size_t(OpKind::sqrt) + 1;
+        constexpr size_t num_sweeps = size_t(Sweep::backward_from_file) + 1;
+
+        const char* sweep_name(Sweep sweep);
+
+        struct OpStats {
+            OpKind kind;
+            uint64_t count = 0;
+            uint64_t tape_bytes = 0;
+            uint64_t forward_ns = 0;
+            uint64_t record_ns = 0;
+        };
+
+        struct SweepStats {
+            Sweep sweep;
+            uint64_t count = 0;
+            uint64_t nodes = 0;
+            uint64_t backward_ns = 0;
+        };
+
+        struct Snapshot {
+            std::vector<OpStats> ops;       // one entry per op kind
+            std::vector<SweepStats> sweeps; // one entry per sweep flavour
+        };
+
+        enum class Format { table, json };
+
+        // Counters summed over every thread that recorded or swept a tape so far
+        Snapshot snapshot();
+        // Print the counters, skipping op kinds and sweeps that never ran
+        void report(std::ostream& os = std::cout, Format format = Format::table);
+        // Zero the counters of every thread
+        void reset();
+
+        namespace detail {
+            using clock = std::chrono::steady_clock;
+
+            inline uint64_t elapsed_ns(clock::time_point start) {
+                return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count());
+            }
+
+            void add_op(OpKind kind, uint64_t forward_ns);
+            void add_record(OpKind kind, uint64_t tape_bytes, uint64_t record_ns);
+            void add_sweep(Sweep sweep, uint64_t nodes, uint64_t backward_ns);
+            uint64_t record_ns(OpKind kind); // of the calling thread
+        } // namespace detail
+
+#ifdef NABLA_PROFILE
+        // Times an operation on reverse-mode variables; the time its nested tape record takes
+        // is subtracted so that only the forward computation is accounted
+        struct OpTimer {
+            explicit OpTimer(OpKind kind)
+                : m_kind{kind}, m_record_ns{detail::record_ns(kind)}, m_start{detail::clock::now()} {}
+            ~OpTimer() {
+                uint64_t elapsed = detail::elapsed_ns(this->m_start);
+                uint64_t recording = detail::record_ns(this->m_kind) - this->m_record_ns;
+                detail::add_op(this->m_kind, elapsed > recording ? elapsed - recording : 0);
+            }
+
+        private:
+            OpKind m_kind;
+            uint64_t m_record_ns;
+            detail::clock::time_point m_start;
+        };
+
+        // Times appending one node to the gradient tape
+        struct RecordTimer {
+            RecordTimer(OpKind kind, uint64_t tape_bytes)
+                : m_kind{kind}, m_tape_bytes{tape_bytes}, m_start{detail::clock::now()} {}
+            ~RecordTimer() { detail::add_record(this->m_kind, this->m_tape_bytes, detail::elapsed_ns(this->m_start)); }
+
+        private:
+            OpKind m_kind;
+            uint64_t m_tape_bytes;
+            detail::clock::time_point m_start;
+        };
+
+        // Times a reverse sweep over `nodes` nodes
+        struct SweepTimer {
+            SweepTimer(Sweep sweep, uint64_t nodes) : m_sweep{sweep}, m_nodes{nodes}, m_start{detail::clock::now()} {}
+            ~SweepTimer() { detail::add_sweep(this->m_sweep, this->m_nodes, detail::elapsed_ns(this->m_start)); }
+
+        private:
+            Sweep m_sweep;
+            uint64_t m_nodes;
+            detail::clock::time_point m_start;
+        };
+#else
+        struct OpTimer {
+            explicit OpTimer(OpKind) {}
+        };
+        struct RecordTimer {
+            RecordTimer(OpKind, uint64_t) {}
+        };
+        struct SweepTimer {
+            SweepTimer(Sweep, uint64_t) {}
+        };
+#endif
+    } // namespace profiler
+} // namespace nabla
+
+#endif
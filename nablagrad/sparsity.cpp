@@ -0,0 +1,282 @@
+#include "sparsity.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+
+namespace nabla {
+    namespace {
+        template <typename T>
+        std::vector<T> merge_sets_(const std::vector<T>& a, const std::vector<T>& b) {
+            if (a.empty()) return b;
+            if (b.empty()) return a;
+            std::vector<T> out;
+            out.reserve(a.size() + b.size());
+            std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(out));
+            return out;
+        }
+
+        // Add every pair (i <= j) of the cartesian product a x b to the pair set `hess`
+        void add_products_(std::vector<std::pair<size_t, size_t>>& hess,
+                           const std::vector<size_t>& a, const std::vector<size_t>& b) {
+            if (a.empty() || b.empty()) return;
+            std::vector<std::pair<size_t, size_t>> product;
+            product.reserve(a.size() * b.size());
+            for (size_t i : a)
+                for (size_t j : b) product.emplace_back(std::min(i, j), std::max(i, j));
+            std::sort(product.begin(), product.end());
+            product.erase(std::unique(product.begin(), product.end()), product.end());
+            hess = merge_sets_(hess, product);
+        }
+
+        // Build a CSR pattern from per-row sorted column sets
+        SparseMatrix pattern_from_rows_(const std::vector<std::vector<size_t>>& rows, size_t cols) {
+            SparseMatrix pattern;
+            pattern.rows = rows.size();
+            pattern.cols = cols;
+            pattern.row_ptr.reserve(rows.size() + 1);
+            for (const auto& row : rows) {
+                pattern.col_index.insert(pattern.col_index.end(), row.begin(), row.end());
+                pattern.row_ptr.push_back(pattern.col_index.size());
+            }
+            return pattern;
+        }
+
+        // Adjacency lists of the graph whose vertices are the columns of a symmetric pattern,
+        // ignoring the diagonal
+        std::vector<std::vector<size_t>> adjacency_(const SparseMatrix& pattern) {
+            std::vector<std::vector<size_t>> adj(pattern.rows);
+            for (size_t i = 0; i < pattern.rows; ++i)
+                for (size_t k = pattern.row_ptr[i]; k < pattern.row_ptr[i + 1]; ++k)
+                    if (pattern.col_index[k] != i) adj[i].push_back(pattern.col_index[k]);
+            return adj;
+        }
+
+        constexpr size_t uncolored_ = std::numeric_limits<size_t>::max();
+
+        // Smallest color not marked as forbidden for vertex `v`
+        size_t first_allowed_color_(const std::vector<size_t>& forbidden, size_t v) {
+            size_t c = 0;
+            while (c < forbidden.size() && forbidden[c] == v) ++c;
+            return c;
+        }
+
+        // Evaluate F with the adjoints of every column of color `c` seeded to 1
+        std::vector<Dual> compressed_sweep_(const std::function<std::vector<Dual>(const std::vector<Dual>&)>& F,
+                                            std::vector<Dual>& dual, const Coloring& coloring, size_t c) {
+            for (size_t j = 0; j < dual.size(); ++j) dual[j].set_adjoint(coloring.colors[j] == c ? 1. : 0.);
+            return F(dual);
+        }
+    } // namespace
+
+    SparsityTracer SparsityTracer::variable(double primal, size_t index) {
+        SparsityTracer t(primal);
+        t.m_deps.push_back(index);
+        return t;
+    }
+
+    SparsityTracer SparsityTracer::nonlinear_(double primal) const {
+        SparsityTracer t(primal);
+        t.m_deps = this->m_deps;
+        t.m_hess = this->m_hess;
+        add_products_(t.m_hess, this->m_deps, this->m_deps);
+        return t;
+    }
+
+    const SparsityTracer& SparsityTracer::operator+=(const SparsityTracer& t) { return *this = *this + t; }
+
+    SparsityTracer operator+(const SparsityTracer& l, const SparsityTracer& r) {
+        SparsityTracer t(l.m_primal + r.m_primal);
+        t.m_deps = merge_sets_(l.m_deps, r.m_deps);
+        t.m_hess = merge_sets_(l.m_hess, r.m_hess);
+        return t;
+    }
+
+    SparsityTracer operator-(const SparsityTracer& l, const SparsityTracer& r) {
+        SparsityTracer t = l + r;
+        t.m_primal = l.m_primal - r.m_primal;
+        return t;
+    }
+
+    SparsityTracer operator*(const SparsityTracer& l, const SparsityTracer& r) {
+        SparsityTracer t = l + r;
+        t.m_primal = l.m_primal * r.m_primal;
+        add_products_(t.m_hess, l.m_deps, r.m_deps);
+        return t;
+    }
+
+    SparsityTracer operator/(const SparsityTracer& l, const SparsityTracer& r) {
+        SparsityTracer t = l * r;
+        t.m_primal = l.m_primal / r.m_primal;
+        add_products_(t.m_hess, r.m_deps, r.m_deps); // 1/r is nonlinear in r
+        return t;
+    }
+
+    SparsityTracer sin(const SparsityTracer& t) { return t.nonlinear_(::sin(t.m_primal)); }
+    SparsityTracer cos(const SparsityTracer& t) { return t.nonlinear_(::cos(t.m_primal)); }
+    SparsityTracer exp(const SparsityTracer& t) { return t.nonlinear_(::exp(t.m_primal)); }
+    SparsityTracer log(const SparsityTracer& t) { return t.nonlinear_(::log(t.m_primal)); }
+    SparsityTracer sqrt(const SparsityTracer& t) { return t.nonlinear_(::sqrt(t.m_primal)); }
+    SparsityTracer power(const SparsityTracer& t, double p) { return t.nonlinear_(::pow(t.m_primal, p)); }
+
+    // abs is piecewise linear: no second order interactions
+    SparsityTracer abs(const SparsityTracer& t) {
+        SparsityTracer a = t;
+        a.m_primal = ::fabs(t.m_primal);
+        return a;
+    }
+
+    SparseMatrix jacobian_sparsity(std::function<TracerVec(const TracerVec&)> F, const std::vector<double>& x) {
+        TracerVec input(x.size());
+        for (size_t i = 0; i < x.size(); ++i) input[i] = SparsityTracer::variable(x[i], i);
+
+        TracerVec output = F(input);
+        std::vector<std::vector<size_t>> rows(output.size());
+        for (size_t i = 0; i < output.size(); ++i) rows[i] = output[i].get_dependencies();
+        return pattern_from_rows_(rows, x.size());
+    }
+
+    SparseMatrix hessian_sparsity(std::function<SparsityTracer(const TracerVec&)> f, const std::vector<double>& x) {
+        TracerVec input(x.size());
+        for (size_t i = 0; i < x.size(); ++i) input[i] = SparsityTracer::variable(x[i], i);
+
+        SparsityTracer output = f(input);
+        std::vector<std::vector<size_t>> rows(x.size());
+        for (const auto& [i, j] : output.get_hessian_dependencies()) {
+            rows[i].push_back(j);
+            if (i != j) rows[j].push_back(i);
+        }
+        for (auto& row : rows) std::sort(row.begin(), row.end());
+        return pattern_from_rows_(rows, x.size());
+    }
+
+    Coloring color_jacobian_columns(const SparseMatrix& pattern) {
+        // rows in which each column has a nonzero (i.e. the transposed pattern)
+        std::vector<std::vector<size_t>> col_rows(pattern.cols);
+        for (size_t i = 0; i < pattern.rows; ++i)
+            for (size_t k = pattern.row_ptr[i]; k < pattern.row_ptr[i + 1]; ++k)
+                col_rows[pattern.col_index[k]].push_back(i);
+
+        Coloring coloring;
+        coloring.colors.assign(pattern.cols, uncolored_);
+        std::vector<size_t> forbidden; // forbidden[c] == j iff color c is forbidden for column j
+
+        for (size_t j = 0; j < pattern.cols; ++j) {
+            for (size_t i : col_rows[j]) {
+                for (size_t k = pattern.row_ptr[i]; k < pattern.row_ptr[i + 1]; ++k) {
+                    size_t c = coloring.colors[pattern.col_index[k]];
+                    if (c != uncolored_) forbidden[c] = j;
+                }
+            }
+            size_t c = first_allowed_color_(forbidden, j);
+            if (c == forbidden.size()) forbidden.push_back(uncolored_);
+            coloring.colors[j] = c;
+        }
+        coloring.num_colors = forbidden.size();
+        return coloring;
+    }
+
+    Coloring star_color_hessian(const SparseMatrix& pattern) {
+        // Greedy star coloring, after Gebremedhin, Manne & Pothen (2005), Algorithm 4.1
+        std::vector<std::vector<size_t>> adj = adjacency_(pattern);
+        size_t n = pattern.rows;
+
+        Coloring coloring;
+        coloring.colors.assign(n, uncolored_);
+        std::vector<size_t>& color = coloring.colors;
+        std::vector<size_t> forbidden;
+
+        for (size_t v = 0; v < n; ++v) {
+            for (size_t w : adj[v]) {
+                if (color[w] != uncolored_) forbidden[color[w]] = v;
+                for (size_t x : adj[w]) {
+                    if (x == v || color[x] == uncolored_) continue;
+                    if (color[w] == uncolored_) {
+                        forbidden[color[x]] = v;
+                        continue;
+                    }
+                    // avoid a bicolored path v-w-x-y with color(v) = color(x), color(w) = color(y)
+                    for (size_t y : adj[x]) {
+                        if (y != w && color[y] == color[w]) {
+                            forbidden[color[x]] = v;
+                            break;
+                        }
+                    }
+                }
+            }
+            size_t c = first_allowed_color_(forbidden, v);
+            if (c == forbidden.size()) forbidden.push_back(uncolored_);
+            color[v] = c;
+        }
+        coloring.num_colors = forbidden.size();
+        return coloring;
+    }
+
+    std::function<SparseMatrix(const std::vector<double>&)> sparse_jacobian(
+        std::function<std::vector<Dual>(const std::vector<Dual>&)> F, const SparseMatrix& pattern
+    ) {
+        Coloring coloring = color_jacobian_columns(pattern);
+
+        auto Jf = [F, pattern, coloring](const std::vector<double>& x) -> SparseMatrix {
+            std::vector<Dual> dual(x.begin(), x.end());
+            SparseMatrix jacobian = pattern;
+            jacobian.values.assign(pattern.nnz(), 0.);
+
+            for (size_t c = 0; c < coloring.num_colors; ++c) {
+                std::vector<Dual> y = compressed_sweep_(F, dual, coloring, c);
+                for (size_t i = 0; i < pattern.rows; ++i)
+                    for (size_t k = pattern.row_ptr[i]; k < pattern.row_ptr[i + 1]; ++k)
+                        if (coloring.colors[pattern.col_index[k]] == c) jacobian.values[k] = y.at(i).get_adjoint();
+            }
+            return jacobian;
+        };
+        return Jf;
+    }
+
+    std::function<SparseMatrix(const std::vector<double>&)> sparse_hessian(
+        std::function<HessianVar(const std::vector<HessianVar>&)> f, const SparseMatrix& pattern
+    ) {
+        Coloring coloring = star_color_hessian(pattern);
+        std::vector<std::vector<size_t>> adj = adjacency_(pattern);
+
+        // For every stored entry (i, j) decide where it is recovered from in the compressed
+        // hessian B = H*S: B(i, color(j)) when j is the only neighbor of i with that color,
+        // B(j, color(i)) otherwise (unique by the star coloring property)
+        std::vector<std::pair<size_t, size_t>> source(pattern.nnz());
+        for (size_t i = 0; i < pattern.rows; ++i) {
+            for (size_t k = pattern.row_ptr[i]; k < pattern.row_ptr[i + 1]; ++k) {
+                size_t j = pattern.col_index[k];
+                size_t same_color = 0;
+                for (size_t w : adj[i]) same_color += coloring.colors[w] == coloring.colors[j];
+                source[k] = (i == j || same_color == 1)
+                    ? std::make_pair(i, coloring.colors[j])
+                    : std::make_pair(j, coloring.colors[i]);
+            }
+        }
+
+        auto Hf = [f, pattern, coloring, source](const std::vector<double>& x) -> SparseMatrix {
+            size_t n = x.size();
+            GradientTape& tape = GradientTape::instance();
+            std::vector<std::vector<double>> compressed(coloring.num_colors);
+            std::vector<double> adjoints;
+            for (size_t c = 0; c < coloring.num_colors; ++c) {
+                GradientTapeRewind rewind(tape);
+                std::vector<HessianVar> dual;
+                dual.reserve(n);
+                for (size_t j = 0; j < n; ++j) dual.emplace_back(Var(x[j]), Var(coloring.colors[j] == c ? 1. : 0.));
+                Var directional = f(dual).get_adjoint(); // s_c^T grad f(x)
+                tape.backward(directional.node_gradtape_index, adjoints);
+                compressed[c].resize(n);
+                for (size_t i = 0; i < n; ++i) compressed[c][i] = adjoints[dual[i].get_primal().node_gradtape_index];
+            }
+
+            SparseMatrix hessian = pattern;
+            hessian.values.resize(pattern.nnz());
+            for (size_t k = 0; k < pattern.nnz(); ++k)
+                hessian.values[k] = compressed[source[k].second].at(source[k].first);
+            return hessian;
+        };
+        return Hf;
+    }
+} // namespace nabla
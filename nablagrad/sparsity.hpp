@@ -0,0 +1,113 @@
+#ifndef SPARSITY_H
+#define SPARSITY_H
+
+#include <iostream>
+#include <functional>
+#include <vector>
+#include <utility>
+
+#include "dual.hpp"
+#include "dual_expr.hpp"
+#include "var.hpp"
+
+namespace nabla {
+    // Number used to detect the sparsity pattern of a function. Alongside its primal value (so
+    // that data-dependent control flow is followed as in a regular evaluation) a tracer carries
+    // the sorted set of input indices it depends on and the set of input pairs (i <= j) that
+    // interact nonlinearly, i.e. the potential nonzeros of the Hessian.
+    struct SparsityTracer {
+        SparsityTracer() : m_primal{0.} {}
+        SparsityTracer(double primal) : m_primal{primal} {}
+
+        // Independent variable with index `index`
+        static SparsityTracer variable(double primal, size_t index);
+
+        double get_primal() const { return this->m_primal; }
+        const std::vector<size_t>& get_dependencies() const { return this->m_deps; }
+        const std::vector<std::pair<size_t, size_t>>& get_hessian_dependencies() const { return this->m_hess; }
+
+        const SparsityTracer& operator+=(const SparsityTracer& t);
+
+        friend SparsityTracer operator+(const SparsityTracer& l, const SparsityTracer& r);
+        friend SparsityTracer operator-(const SparsityTracer& l, const SparsityTracer& r);
+        friend SparsityTracer operator*(const SparsityTracer& l, const SparsityTracer& r);
+        friend SparsityTracer operator/(const SparsityTracer& l, const SparsityTracer& r);
+
+        friend SparsityTracer sin(const SparsityTracer& t);
+        friend SparsityTracer cos(const SparsityTracer& t);
+        friend SparsityTracer exp(const SparsityTracer& t);
+        friend SparsityTracer log(const SparsityTracer& t);
+        friend SparsityTracer abs(const SparsityTracer& t);
+        friend SparsityTracer power(const SparsityTracer& t, double pow);
+        friend SparsityTracer sqrt(const SparsityTracer& t);
+
+    private:
+        // Result of a nonlinear unary function applied to this tracer
+        SparsityTracer nonlinear_(double primal) const;
+
+        double m_primal;
+        std::vector<size_t> m_deps;
+        std::vector<std::pair<size_t, size_t>> m_hess;
+    };
+
+    using TracerVec = std::vector<SparsityTracer>;
+
+    // Sparse matrix in compressed sparse row (CSR) format. Column indices are sorted within
+    // each row. `values` is empty when the matrix only represents a sparsity pattern.
+    struct SparseMatrix {
+        size_t rows = 0;
+        size_t cols = 0;
+        std::vector<size_t> row_ptr{0}; // size rows + 1
+        std::vector<size_t> col_index;
+        std::vector<double> values;
+
+        size_t nnz() const { return this->col_index.size(); }
+
+        friend std::ostream& operator<<(std::ostream& os, const SparseMatrix& sm) {
+            os << "nabla::SparseMatrix[shape: (" << sm.rows << ", " << sm.cols << "), nnz: " << sm.nnz() << "]";
+            return os;
+        }
+    };
+
+    // Assignment of a color to every column (or vertex) of a matrix. Columns sharing a color are
+    // evaluated together in a single seeded sweep.
+    struct Coloring {
+        size_t num_colors = 0;
+        std::vector<size_t> colors;
+    };
+
+    // Sparsity pattern of the jacobian of F:R^n->R^m at x, detected with one evaluation of F
+    SparseMatrix jacobian_sparsity(std::function<TracerVec(const TracerVec&)> F, const std::vector<double>& x);
+
+    // Sparsity pattern of the (symmetric) hessian of f:R^n->R at x, detected with one evaluation of f
+    SparseMatrix hessian_sparsity(std::function<SparsityTracer(const TracerVec&)> f, const std::vector<double>& x);
+
+    // Greedy distance-1 coloring of the column intersection graph: columns sharing a nonzero
+    // row get different colors, so that each compressed column holds at most one nonzero per row
+    Coloring color_jacobian_columns(const SparseMatrix& pattern);
+
+    // Greedy star coloring of the adjacency graph of a symmetric pattern: a distance-1 coloring
+    // where every path on four vertices uses at least three colors, which allows recovering every
+    // hessian entry from the compressed hessian while using fewer colors than distance-2 coloring
+    Coloring star_color_hessian(const SparseMatrix& pattern);
+
+    // Sparse jacobian of F:R^n->R^m with the given sparsity pattern. Takes one forward-mode
+    // sweep of F per color of `color_jacobian_columns(pattern)`.
+    std::function<SparseMatrix(const std::vector<double>&)> sparse_jacobian(
+        std::function<std::vector<Dual>(const std::vector<Dual>&)> F, const SparseMatrix& pattern);
+
+    // Forward-over-reverse scalar: a forward-mode dual whose primal and tangent are reverse-mode
+    // variables, so that the tangent of a result can be differentiated again on the tape
+    using HessianVar = et::Dual<Var>;
+
+    // Sparse hessian of f:R^n->R with the given (symmetric) sparsity pattern, by
+    // forward-over-reverse AD of f. For every color c of `star_color_hessian(pattern)` f is
+    // recorded on duals seeded with the tangent s_c (1 on the inputs of color c), which makes the
+    // tangent of the result the directional derivative s_c^T grad f(x); one reverse sweep from
+    // it gives the compressed hessian column H*s_c. Takes one recording and one sweep of f per
+    // color. The recordings are dropped from the active tape.
+    std::function<SparseMatrix(const std::vector<double>&)> sparse_hessian(
+        std::function<HessianVar(const std::vector<HessianVar>&)> f, const SparseMatrix& pattern);
+} // namespace nabla
+
+#endif
@@ -0,0 +1,140 @@
+#include "tape_file.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nabla {
+    namespace {
+        constexpr char tape_file_magic_[8] = { 'N', 'A', 'B', 'L', 'A', 'T', 'P', '1' };
+        constexpr size_t write_chunk_nodes_ = 1 << 14;
+        constexpr size_t sweep_window_nodes_ = 1 << 16;
+
+        // Issue madvise() on the pages overlapping [begin, end) of a mapping starting at `base`
+        void advise_(const char* base, size_t begin, size_t end, int advice) {
+            static const size_t page = sysconf(_SC_PAGESIZE);
+            size_t aligned = begin - begin % page;
+            if (end > aligned) madvise(const_cast<char*>(base) + aligned, end - aligned, advice);
+        }
+    } // namespace
+
+    TapeFileWriter::TapeFileWriter(const std::string& path) : m_path{path} {
+        this->m_file = std::fopen(path.c_str(), "wb");
+        if (!this->m_file) throw std::runtime_error("TapeFileWriter: cannot open " + path);
+
+        TapeFileHeader header{};
+        std::memcpy(header.magic, tape_file_magic_, sizeof(header.magic));
+        std::fwrite(&header, sizeof(header), 1, this->m_file);
+        this->m_buffer.reserve(write_chunk_nodes_);
+    }
+
+    TapeFileWriter::~TapeFileWriter() {
+        try { this->close(); } catch (...) {}
+    }
+
+    void TapeFileWriter::write(const double* weight0, const double* weight1,
+                               const node_index_t* parent0, const node_index_t* parent1, size_t count) {
+        if (!this->m_file) throw std::logic_error("TapeFileWriter: write after close");
+
+        for (size_t begin = 0; begin < count; begin += write_chunk_nodes_) {
+            size_t end = std::min(count, begin + write_chunk_nodes_);
+            this->m_buffer.clear();
+            for (size_t i = begin; i < end; ++i)
+                this->m_buffer.push_back({ weight0[i], weight1[i], parent0[i], parent1[i] });
+            if (std::fwrite(this->m_buffer.data(), sizeof(TapeFileRecord), this->m_buffer.size(), this->m_file)
+                    != this->m_buffer.size())
+                throw std::runtime_error("TapeFileWriter: cannot write " + this->m_path);
+        }
+        this->m_node_count += count;
+    }
+
+    void TapeFileWriter::close() {
+        if (!this->m_file) return;
+        uint64_t node_count = this->m_node_count;
+        std::fseek(this->m_file, offsetof(TapeFileHeader, node_count), SEEK_SET);
+        std::fwrite(&node_count, sizeof(node_count), 1, this->m_file);
+        bool failed = std::fclose(this->m_file) != 0;
+        this->m_file = nullptr;
+        if (failed) throw std::runtime_error("TapeFileWriter: cannot write " + this->m_path);
+    }
+
+    void backward_from_file(const std::string& path, node_index_t output, std::vector<double>& adjoints) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("backward_from_file: cannot open " + path);
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(TapeFileHeader)) {
+            ::close(fd);
+            throw std::runtime_error("backward_from_file: " + path + " is not a tape file");
+        }
+        size_t file_size = st.st_size;
+        void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) throw std::runtime_error("backward_from_file: cannot map " + path);
+        const char* base = static_cast<const char*>(mapping);
+
+        TapeFileHeader header;
+        std::memcpy(&header, base, sizeof(header));
+        size_t node_count = header.node_count;
+        if (std::memcmp(header.magic, tape_file_magic_, sizeof(header.magic)) != 0
+                || node_count > (file_size - sizeof(header)) / sizeof(TapeFileRecord)) {
+            munmap(mapping, file_size);
+            throw std::runtime_error("backward_from_file: " + path + " is not a tape file");
+        }
+        if (output < 0) output = node_count - 1;
+        if (size_t(output) >= node_count) {
+            munmap(mapping, file_size);
+            throw std::out_of_range("backward_from_file: output node is not in the tape file");
+        }
+
+        const size_t records_offset = sizeof(header);
+        const TapeFileRecord* records = reinterpret_cast<const TapeFileRecord*>(base + records_offset);
+        profiler::SweepTimer timer(profiler::Sweep::backward_from_file, size_t(output) + 1);
+        adjoints.assign(node_count, 0.);
+        adjoints[output] = 1.;
+
+        // sweep windows of records from the end of the file towards its beginning
+        size_t window_end = output + 1;
+        while (window_end > 0) {
+            size_t window_begin = window_end > sweep_window_nodes_ ? window_end - sweep_window_nodes_ : 0;
+            if (window_begin > 0) {
+                size_t prev_begin = window_begin > sweep_window_nodes_ ? window_begin - sweep_window_nodes_ : 0;
+                advise_(base, records_offset + prev_begin * sizeof(TapeFileRecord),
+                        records_offset + window_begin * sizeof(TapeFileRecord), MADV_WILLNEED);
+            }
+
+            for (size_t i = window_end; i-- > window_begin;) {
+                const TapeFileRecord& r = records[i];
+                // a node only depends on itself (leaves) or earlier nodes
+                if (r.parent0 < 0 || r.parent1 < 0 || size_t(r.parent0) > i || size_t(r.parent1) > i) {
+                    munmap(mapping, file_size);
+                    throw std::runtime_error("backward_from_file: " + path + " has an invalid record at node "
+                                             + std::to_string(i));
+                }
+                double adjoint = adjoints[i];
+                if (adjoint == 0.) continue;
+                adjoints[r.parent0] += r.weight0 * adjoint;
+                adjoints[r.parent1] += r.weight1 * adjoint;
+            }
+
+            advise_(base, records_offset + window_begin * sizeof(TapeFileRecord),
+                    records_offset + window_end * sizeof(TapeFileRecord), MADV_DONTNEED);
+            window_end = window_begin;
+        }
+        munmap(mapping, file_size);
+    }
+
+    std::vector<double> backward_from_file(const std::string& path, node_index_t output) {
+        std::vector<double> adjoints;
+        backward_from_file(path, output, adjoints);
+        return adjoints;
+    }
+} // namespace nabla
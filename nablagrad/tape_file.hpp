@@ -0,0 +1,59 @@
+#ifndef TAPE_FILE_H
+#define TAPE_FILE_H
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gradient_tape.hpp"
+
+namespace nabla {
+    // On-disk gradient tape format: a `TapeFileHeader` followed by `node_count` fixed-width
+    // `TapeFileRecord`s in tape order, in native byte order.
+    struct TapeFileHeader {
+        char magic[8];
+        uint64_t node_count;
+    };
+
+    struct TapeFileRecord {
+        double weight0;
+        double weight1;
+        node_index_t parent0;
+        node_index_t parent1;
+    };
+    static_assert(sizeof(TapeFileRecord) == 24, "tape file records must be 24 bytes wide");
+
+    // Sequential writer of gradient tape nodes to a tape file. The header's node count is
+    // written when the writer is closed.
+    struct TapeFileWriter {
+        explicit TapeFileWriter(const std::string& path);
+        ~TapeFileWriter();
+        TapeFileWriter(const TapeFileWriter&) = delete;
+        TapeFileWriter& operator=(const TapeFileWriter&) = delete;
+
+        // Append `count` nodes given as struct-of-arrays (the layout of `GradientTape`)
+        void write(const double* weight0, const double* weight1,
+                   const node_index_t* parent0, const node_index_t* parent1, size_t count);
+        void close();
+
+        const std::string& path() const { return this->m_path; }
+        size_t size() const { return this->m_node_count; }
+
+    private:
+        std::string m_path;
+        std::FILE* m_file = nullptr;
+        size_t m_node_count = 0;
+        std::vector<TapeFileRecord> m_buffer;
+    };
+
+    // Reverse sweep over a tape file seeded with an adjoint of 1 at node `output` (the last node
+    // of the file if negative). The file is memory-mapped and read backwards window by window,
+    // hinting the kernel to read ahead the next window and to drop the ones already swept.
+    // Throws std::runtime_error if the file is not a tape file or holds a record whose parents
+    // are not earlier nodes (e.g. a truncated or corrupted file).
+    void backward_from_file(const std::string& path, node_index_t output, std::vector<double>& adjoints);
+    std::vector<double> backward_from_file(const std::string& path, node_index_t output=-1);
+} // namespace nabla
+
+#endif
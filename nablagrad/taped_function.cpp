@@ -0,0 +1,107 @@
+#include "taped_function.hpp"
+
+#include <cmath>
+
+namespace nabla {
+    bool compare(CmpKind cmp, double lhs, double rhs) {
+        switch (cmp) {
+            case CmpKind::lt: return lhs < rhs;
+            case CmpKind::le: return lhs <= rhs;
+            case CmpKind::gt: return lhs > rhs;
+            case CmpKind::ge: return lhs >= rhs;
+            case CmpKind::eq: return lhs == rhs;
+            case CmpKind::ne: return lhs != rhs;
+        }
+        return false;
+    }
+
+    double TapedFunction::operator()(const std::vector<double>& x) {
+        this->evaluate_(x);
+        return this->m_values[this->m_output];
+    }
+
+    Gradient TapedFunction::grad(const std::vector<double>& x) {
+        this->evaluate_(x);
+
+        size_t n = this->m_code.size();
+        this->m_adjoints.assign(n, 0.);
+        this->m_adjoints[this->m_output] = 1.;
+        for (node_index_t i = this->m_output; i >= 0; --i) {
+            double adjoint = this->m_adjoints[i];
+            if (adjoint == 0.) continue;
+            const Instruction& ins = this->m_code[i];
+            this->m_adjoints[ins.lhs] += this->m_weight0[i] * adjoint;
+            this->m_adjoints[ins.rhs] += this->m_weight1[i] * adjoint;
+        }
+        return Gradient(this->m_adjoints.begin(), this->m_adjoints.begin() + this->m_inputs);
+    }
+
+    void TapedFunction::evaluate_(const std::vector<double>& x) {
+        if (this->m_traced && x.size() == this->m_inputs && this->forward_(x)) return;
+        this->trace_(x);
+        this->forward_(x);
+    }
+
+    void TapedFunction::trace_(const std::vector<double>& x) {
+        if (this->m_traced) ++this->m_retraces;
+
+        OpRecorder recorder;
+        OpRecorder* previous_recorder = OpRecorder::active();
+        OpRecorder::active() = &recorder;
+        {
+            GradientTapeScope scope(this->m_trace_tape);
+            GradientTape::mark_t mark = this->m_trace_tape.mark();
+            try {
+                std::vector<Var> input(x.begin(), x.end()); // instructions 0..n-1
+                this->m_output = this->m_function(input).node_gradtape_index;
+            } catch (...) {
+                OpRecorder::active() = previous_recorder;
+                this->m_trace_tape.rewind(mark);
+                throw;
+            }
+            this->m_trace_tape.rewind(mark);
+        }
+        OpRecorder::active() = previous_recorder;
+
+        this->m_inputs = x.size();
+        this->m_code = std::move(recorder.instructions);
+        this->m_guards = std::move(recorder.guards);
+        this->m_traced = true;
+    }
+
+    bool TapedFunction::forward_(const std::vector<double>& x) {
+        size_t n = this->m_code.size();
+        this->m_values.resize(n);
+        this->m_weight0.resize(n);
+        this->m_weight1.resize(n);
+        double* v = this->m_values.data();
+
+        for (size_t i = 0; i < n; ++i) {
+            const Instruction& ins = this->m_code[i];
+            double a = v[ins.lhs];
+            double b = v[ins.rhs];
+            double w0 = 0., w1 = 0., val = 0.;
+            switch (ins.kind) {
+                case OpKind::leaf: val = i < this->m_inputs ? x[i] : ins.constant; break;
+                case OpKind::add: val = a + b; w0 = 1.; w1 = 1.; break;
+                case OpKind::sub: val = a - b; w0 = 1.; w1 = -1.; break;
+                case OpKind::mul: val = a * b; w0 = b; w1 = a; break;
+                case OpKind::div: val = a / b; w0 = 1 / b; w1 = -val / b; break;
+                case OpKind::exp: val = ::exp(a); w0 = val; break;
+                case OpKind::log: val = ::log(a); w0 = 1 / a; break;
+                case OpKind::power: val = ::pow(a, ins.constant); w0 = ins.constant * ::pow(a, ins.constant - 1); break;
+                case OpKind::sin: val = ::sin(a); w0 = ::cos(a); break;
+                case OpKind::cos: val = ::cos(a); w0 = -::sin(a); break;
+                case OpKind::abs: val = ::fabs(a); w0 = a == 0 ? 0 : (a > 0 ? 1 : -1); break;
+                case OpKind::sqrt: val = ::sqrt(a); w0 = 0.5 / val; break;
+            }
+            v[i] = val;
+            this->m_weight0[i] = w0;
+            this->m_weight1[i] = w1;
+        }
+
+        for (const BranchGuard& guard : this->m_guards)
+            if (compare(guard.cmp, v[guard.lhs], v[guard.rhs]) != guard.outcome) return false;
+        return true;
+    }
+} // namespace nabla
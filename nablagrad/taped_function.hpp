@@ -0,0 +1,87 @@
+#ifndef TAPED_FUNCTION_H
+#define TAPED_FUNCTION_H
+
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+#include "gradient_tape.hpp"
+#include "var.hpp"
+
+namespace nabla {
+    enum class CmpKind : uint8_t { lt, le, gt, ge, eq, ne };
+
+    bool compare(CmpKind cmp, double lhs, double rhs);
+
+    // Single operation in a recorded opcode stream. `lhs` and `rhs` are the indices of the
+    // operands in the stream (`rhs` is unused by unary ops). `constant` holds the value of
+    // constant leaves and the exponent of `power`.
+    struct Instruction {
+        OpKind kind;
+        node_index_t lhs;
+        node_index_t rhs;
+        double constant;
+    };
+
+    // Outcome of a comparison between two variables taken while recording. Replaying the
+    // recording is only valid while every guard evaluates to the same outcome.
+    struct BranchGuard {
+        CmpKind cmp;
+        node_index_t lhs;
+        node_index_t rhs;
+        bool outcome;
+    };
+
+    // Records the opcode stream and branch guards of the reverse-mode operations performed by
+    // the calling thread while it is the active recorder (see `TapedFunction`).
+    struct OpRecorder {
+        std::vector<Instruction> instructions;
+        std::vector<BranchGuard> guards;
+
+        static OpRecorder*& active() {
+            thread_local OpRecorder* active_recorder = nullptr;
+            return active_recorder;
+        }
+    };
+
+    // Record-once, replay-many reverse-mode function f:R^n->R. The first evaluation traces `f`
+    // through nabla::Var operator overloading and keeps the resulting opcode stream; later
+    // evaluations re-run the forward and reverse sweeps directly from that stream, without
+    // operator overloading or tape recording. Comparisons between nabla::Var values taken by
+    // `f` are recorded as branch guards: when a guard flips for new inputs (or the input size
+    // changes) `f` is traced again. Branches on `get_primal()` are not guarded, so `f` must not
+    // use them to select between different computations.
+    struct TapedFunction {
+        explicit TapedFunction(std::function<Var(const std::vector<Var>&)> f) : m_function{f} {}
+
+        double operator()(const std::vector<double>& x);
+        Gradient grad(const std::vector<double>& x);
+
+        size_t size() const { return this->m_code.size(); }
+        size_t retrace_count() const { return this->m_retraces; }
+
+    private:
+        void trace_(const std::vector<double>& x);
+        // Replay the forward sweep, computing values and local gradients. Returns false if a
+        // branch guard does not hold for `x`.
+        bool forward_(const std::vector<double>& x);
+        void evaluate_(const std::vector<double>& x);
+
+        std::function<Var(const std::vector<Var>&)> m_function;
+        size_t m_inputs = 0;
+        node_index_t m_output = -1;
+        size_t m_retraces = 0;
+        bool m_traced = false;
+
+        std::vector<Instruction> m_code;
+        std::vector<BranchGuard> m_guards;
+        GradientTape m_trace_tape;
+
+        std::vector<double> m_values;
+        std::vector<double> m_weight0;
+        std::vector<double> m_weight1;
+        std::vector<double> m_adjoints;
+    };
+} // namespace nabla
+
+#endif
@@ -1,51 +1,53 @@
 #include "tensor.hpp"
 #include "autograd.hpp"
+#include "tensor_kernels.hpp"
 
 #include <iostream>
 #include <iomanip>
-#include <execution>
 #include <algorithm> // std::reverse
+#include <stdexcept>
+#include <type_traits>
 
 namespace nabla {
 
     // tensor base constructor
-    Tensor::Tensor(const std::string& name, const std::vector<size_t>& shape, bool requires_grad, bool ir)
+    template<typename T>
+    BasicTensor<T>::BasicTensor(const std::string& name, const std::vector<size_t>& shape, bool requires_grad, bool ir)
         : name_{name}, shape_{shape}, requires_grad_{requires_grad}
     {
         stride_ = _compute_stride_from_shape_(shape_);
-        size_ = std::accumulate(shape.begin(), shape.end(), 1, std::multiplies<size_t>());
-        data_ = std::vector<double>(size_);
+        size_ = std::accumulate(shape.begin(), shape.end(), size_t(1), std::multiplies<size_t>());
+        storage_ = std::make_shared<TensorStorage<T>>(size_);
 
-        if (requires_grad && !ir) autograd::ComputationGraph::push_leaf(*this);
+        if (requires_grad && !ir) autograd::ComputationGraph<T>::push_leaf(*this);
     }
 
-    Tensor::Tensor(const std::vector<size_t>& shape, bool requires_grad, bool ir)
-        : Tensor(_generate_default_name_(), shape, requires_grad, ir) {}
+    template<typename T>
+    BasicTensor<T>::BasicTensor(const std::vector<size_t>& shape, bool requires_grad, bool ir)
+        : BasicTensor(_generate_default_name_(), shape, requires_grad, ir) {}
 
-    Tensor Tensor::rand(const std::vector<size_t>& shape, bool requires_grad) {
-        Tensor rand_tensor(shape, requires_grad);
-        rand_tensor.data_ = generate_rand_vect<double>(rand_tensor.size());
+    template<typename T>
+    BasicTensor<T> BasicTensor<T>::rand(const std::vector<size_t>& shape, bool requires_grad) {
+        BasicTensor rand_tensor(shape, requires_grad);
+        fill_rand_vect(*rand_tensor.storage_); // in place, no second buffer
         return rand_tensor;
     }
 
-    Tensor Tensor::zeros(const std::vector<size_t>& shape, bool requires_grad) {
-        Tensor zeros_tensor(shape, requires_grad);
-        std::vector<double> tensor_data(zeros_tensor.size());
-        fill(tensor_data.begin(), tensor_data.end(), 0);
-        zeros_tensor.data_ = tensor_data;
-        return zeros_tensor;
+    template<typename T>
+    BasicTensor<T> BasicTensor<T>::zeros(const std::vector<size_t>& shape, bool requires_grad) {
+        return BasicTensor(shape, requires_grad); // storage is value-initialized
     }
 
-    Tensor Tensor::ones(const std::vector<size_t>& shape, bool requires_grad) {
-        Tensor ones_tensor(shape, requires_grad);
-        std::vector<double> tensor_data(ones_tensor.size());
-        fill(tensor_data.begin(), tensor_data.end(), 1);
-        ones_tensor.data_ = tensor_data;
+    template<typename T>
+    BasicTensor<T> BasicTensor<T>::ones(const std::vector<size_t>& shape, bool requires_grad) {
+        BasicTensor ones_tensor(shape, requires_grad);
+        std::fill(ones_tensor.storage_->begin(), ones_tensor.storage_->end(), T(1));
         return ones_tensor;
     }
 
-    void Tensor::backward() const {
-        Tensor upstream_grad = Tensor::ones({size_}); // init acc local grad to 1
+    template<typename T>
+    void BasicTensor<T>::backward() const {
+        BasicTensor upstream_grad = BasicTensor::ones({size_}); // init acc local grad to 1
         // init gradient propagation through computation nodes from this tensor
         /* const ComputationNode& cnode = ComputationGraph::get_operator(cg_node_idx_); */
         /* cnode.backward(upstream_grad); */
@@ -84,99 +86,180 @@ namespace nabla {
     /*     } */
     /* } */
 
-    std::string Tensor::_generate_default_name_() {
-        return "tensor_" + std::to_string(tensor_next_id_++);
+    // shared by the tensors of every element type
+    static int tensor_next_id = 0;
+
+    template<typename T>
+    std::string BasicTensor<T>::_generate_default_name_() {
+        return "tensor_" + std::to_string(tensor_next_id++);
+    }
+
+    template<typename T>
+    T& BasicTensor<T>::at(const std::vector<size_t>& indices) {
+        return data()[_flatten_index_(indices)];
     }
 
-    double& Tensor::at(const std::vector<size_t>& indices) {
-        return data_[_flatten_index_(indices)];
+    template<typename T>
+    const T& BasicTensor<T>::at(const std::vector<size_t>& indices) const {
+        return data()[_flatten_index_(indices)];
     }
 
-    const double& Tensor::at(const std::vector<size_t>& indices) const {
-        return data_[_flatten_index_(indices)];
+    template<typename T>
+    BasicTensor<T> BasicTensor<T>::at(size_t index, size_t dim) const {
+        if (dim >= shape_.size()) throw std::out_of_range("at: dimension out of range");
+        if (index >= shape_[dim]) throw std::out_of_range("at: index out of bounds");
+
+        // drop dimension `dim` from the layout and move to the selected position along it
+        std::vector<size_t> eshape(shape_), estride(stride_);
+        eshape.erase(eshape.begin() + dim);
+        estride.erase(estride.begin() + dim);
+        return _view_(eshape, estride, offset_ + index * stride_[dim]);
     }
 
-    Tensor Tensor::at(size_t index, size_t dim) const {
-        size_t begin_idx = stride_[dim] * index;
-        std::vector<double> td;
-        size_t offset;
-        if (dim == shape_.size() - 1) offset = 0;
-        else offset = stride_[dim + 1];
-        for (size_t i = begin_idx; i < begin_idx + stride_[dim]; i += offset) {
-            td.push_back(data_[i]);
+    template<typename T>
+    bool BasicTensor<T>::is_contiguous() const {
+        size_t expected = 1;
+        for (size_t d = shape_.size(); d-- > 0;) {
+            if (shape_[d] != 1 && stride_[d] != expected) return false;
+            expected *= shape_[d];
         }
+        return true;
+    }
 
-        // compute shape of the retrieved subtensor
-        std::vector<size_t> eshape;
-        for (size_t i = dim + 1; i < shape_.size(); i++) eshape.push_back(shape_[i]);
+    template<typename T>
+    BasicTensor<T> BasicTensor<T>::contiguous() const {
+        if (is_contiguous()) return *this;
 
-        Tensor attensor(eshape, requires_grad_, false);
-        attensor.data_ = td;
-        return attensor;
+        BasicTensor contiguous_tensor = _view_(shape_, _compute_stride_from_shape_(shape_), 0);
+        contiguous_tensor.storage_ = std::make_shared<TensorStorage<T>>(size_);
+        kernels::copy_to_contiguous(data(), shape_, stride_, contiguous_tensor.data());
+        return contiguous_tensor;
     }
 
-    Tensor Tensor::apply_transform(std::function<double(double)> transformation) const {
-        std::vector<double> t_data(data_);
-        std::transform(t_data.begin(), t_data.end(), t_data.begin(), [&transformation](double x) {
-            return transformation(x); });
+    template<typename T>
+    BasicTensor<T> BasicTensor<T>::reshape(const std::vector<size_t>& shape) const {
+        size_t size = std::accumulate(shape.begin(), shape.end(), size_t(1), std::multiplies<size_t>());
+        if (size != size_) throw std::invalid_argument("reshape: number of elements differs");
+
+        BasicTensor base = contiguous();
+        return base._view_(shape, _compute_stride_from_shape_(shape), base.offset_);
+    }
 
-        Tensor tens(shape_, requires_grad_);
-        tens.data_ = t_data;
-        return tens;
+    template<typename T>
+    std::vector<T> BasicTensor<T>::raw_data() const {
+        std::vector<T> values(size_);
+        if (size_ > 0) kernels::copy_to_contiguous(data(), shape_, stride_, values.data());
+        return values;
     }
 
-    Tensor Tensor::t() const {
-        if (shape_.size() > 2)
-            std::cerr << "t(): Cannot transpose a tensor with dimension > 2" << std::endl;
+    template<typename T>
+    void BasicTensor<T>::setdata(std::vector<T> v) {
+        if (v.size() != size_) throw std::invalid_argument("setdata: number of elements differs");
+        storage_ = std::make_shared<TensorStorage<T>>(v.begin(), v.end());
+        stride_ = _compute_stride_from_shape_(shape_);
+        offset_ = 0;
+    }
 
-        if (shape_.size() == 1) {
-            Tensor t_tensor(shape_, requires_grad_);
-            t_tensor.data_ = data_;
-            return t_tensor;
+    template<typename T>
+    BasicTensor<T> BasicTensor<T>::permute(const std::vector<size_t>& dims) const {
+        if (dims.size() != shape_.size())
+            throw std::invalid_argument("permute: expected one index per dimension");
+
+        std::vector<size_t> p_shape(dims.size()), p_stride(dims.size());
+        std::vector<bool> seen(dims.size(), false);
+        for (size_t i = 0; i < dims.size(); i++) {
+            if (dims[i] >= dims.size() || seen[dims[i]])
+                throw std::invalid_argument("permute: dims is not a permutation of the dimensions");
+            seen[dims[i]] = true;
+            p_shape[i] = shape_[dims[i]];
+            p_stride[i] = stride_[dims[i]];
         }
+        return _view_(p_shape, p_stride, offset_);
+    }
+
+    template<typename T>
+    BasicTensor<T> BasicTensor<T>::transpose(size_t dim0, size_t dim1) const {
+        if (dim0 >= shape_.size() || dim1 >= shape_.size())
+            throw std::out_of_range("transpose: dimension out of range");
 
-        std::vector<size_t> t_shape(shape_);
-        std::reverse(t_shape.begin(), t_shape.end());
-        Tensor t_tensor(t_shape, requires_grad_);
-        t_tensor.data_ = data_;
-        return t_tensor;
+        std::vector<size_t> dims(shape_.size());
+        std::iota(dims.begin(), dims.end(), 0);
+        std::swap(dims[dim0], dims[dim1]);
+        return permute(dims);
     }
 
-    std::vector<size_t> Tensor::_compute_stride_from_shape_(const std::vector<size_t>& shape) const {
+    template<typename T>
+    BasicTensor<T> BasicTensor<T>::t() const {
+        std::vector<size_t> dims(shape_.size());
+        std::iota(dims.rbegin(), dims.rend(), 0);
+        return permute(dims);
+    }
+
+    template<typename T>
+    BasicTensor<T> BasicTensor<T>::broadcast_to(const std::vector<size_t>& shape) const {
+        if (shape.size() < shape_.size())
+            throw std::invalid_argument("broadcast_to: target shape has fewer dimensions");
+
+        size_t lead = shape.size() - shape_.size();
+        std::vector<size_t> b_stride(shape.size(), 0);
+        for (size_t i = 0; i < shape_.size(); i++) {
+            if (shape_[i] == shape[lead + i]) b_stride[lead + i] = stride_[i];
+            else if (shape_[i] != 1) throw std::invalid_argument("broadcast_to: shapes are not compatible");
+        }
+        return _view_(shape, b_stride, offset_);
+    }
+
+    template<typename T>
+    BasicTensor<T> BasicTensor<T>::_view_(std::vector<size_t> shape, std::vector<size_t> stride, size_t offset) const {
+        BasicTensor view;
+        view.name_ = name_;
+        view.shape_ = std::move(shape);
+        view.stride_ = std::move(stride);
+        view.storage_ = storage_;
+        view.offset_ = offset;
+        view.size_ = std::accumulate(view.shape_.begin(), view.shape_.end(), size_t(1), std::multiplies<size_t>());
+        view.requires_grad_ = requires_grad_;
+        return view;
+    }
+
+    template<typename T>
+    std::vector<size_t> BasicTensor<T>::_compute_stride_from_shape_(const std::vector<size_t>& shape) const {
         std::vector<size_t> stride(shape.size());
-        stride[shape.size() - 1] = 1;
-        for (int i = shape.size() - 2; i >= 0; i--)
-            stride[i] = stride[i + 1] * shape[i + 1];
+        size_t current_stride = 1;
+        for (size_t i = shape.size(); i-- > 0;) {
+            stride[i] = current_stride;
+            current_stride *= shape[i];
+        }
         return stride;
     }
 
-    size_t Tensor::_flatten_index_(const std::vector<size_t>& indices) const {
+    template<typename T>
+    size_t BasicTensor<T>::_flatten_index_(const std::vector<size_t>& indices) const {
         if (indices.size() != shape_.size())
             throw std::out_of_range("Incorrect tensor shape");
 
         size_t index = 0;
-        size_t current_stride = 1;
-        for (size_t i = indices.size() - 1; i >= 0; i--) {
+        for (size_t i = 0; i < indices.size(); i++) {
             if (indices[i] >= shape_[i])
                 throw std::out_of_range("Out of bounds");
-
-            index += indices[i] * current_stride;
-            current_stride *= shape_[i];
+            index += indices[i] * stride_[i];
         }
         return index;
     }
 
-    std::string Tensor::_data_to_string_(size_t index0, size_t dim) const {
+    template<typename T>
+    std::string BasicTensor<T>::_data_to_string_(size_t offset0, size_t dim) const {
+        if (shape_.empty()) return std::to_string(data()[0]);
+
         std::string data_str = "[";
 
         // Base case for recursion: innermost dimension
         if (dim == shape_.size() - 1) {
             // here 'shape_[dim]' is the number of elements in the current (innermost)
-            // dimension. Since data is stored in 'row-major' format just iterate over the
-            // base data vector interval [index0, index0 + shape_[dim] - 1]
-            for (size_t i = index0; i <= index0 + shape_[dim] - 1; i++) {
-                data_str.append(std::to_string(data_[i]));
-                if (i != index0 + shape_[dim] - 1) data_str.append(", ");
+            // dimension, 'stride_[dim]' apart from each other in the storage
+            for (size_t i = 0; i < shape_[dim]; i++) {
+                data_str.append(std::to_string(data()[offset0 + i * stride_[dim]]));
+                if (i != shape_[dim] - 1) data_str.append(", ");
             }
             data_str.append("]");
             return data_str;
@@ -184,7 +267,7 @@ namespace nabla {
 
         // Iterate over each element in the current dimension
         for (size_t i = 0; i < shape_[dim]; i++) {
-            data_str.append(_data_to_string_(index0, dim + 1));
+            data_str.append(_data_to_string_(offset0, dim + 1));
             if (i != shape_[dim] - 1) {
                 data_str.append("\n"); // each element in a separate line
                 // for tensors with ndim > 2 each element in the current dimension is separated by
@@ -195,13 +278,14 @@ namespace nabla {
                 // according to its dimension
                 for (size_t j = 0; j <= dim; j++) data_str.append(" ");
             }
-            index0 += stride_[dim]; // add offset between elements in the current dimension
+            offset0 += stride_[dim]; // add offset between elements in the current dimension
         }
         data_str.append("]");
         return data_str;
     }
 
-    std::ostream& operator<<(std::ostream& os, const Tensor& tensor) {
+    template<typename T>
+    std::ostream& operator<<(std::ostream& os, const BasicTensor<T>& tensor) {
         os << std::boolalpha; // true/false for booleans instead of 1/0
         os << "nabla::Tensor[shape: (";
         // For some reason printing 'tensor.shape_' directly leads to an infinite
@@ -213,4 +297,170 @@ namespace nabla {
         return os;
     }
 
+
+    template<typename T>
+    BasicTensor<T> batched_matmul(const BasicTensor<T>& a, const BasicTensor<T>& b, bool ir) {
+        if (a.ndim() == 0 || b.ndim() == 0)
+            throw std::invalid_argument("matmul: operands must have at least one dimension");
+
+        // 1-d operands as [1, k] and [k, 1] matrices (stride-0 views, nothing is copied)
+        BasicTensor<T> a2 = a.ndim() == 1 ? a.broadcast_to({ 1, a.size() }) : a;
+        BasicTensor<T> b2 = b.ndim() == 1 ? b.broadcast_to({ 1, b.size() }).t() : b;
+        size_t m = a2.shape()[a2.ndim() - 2], k = a2.shape().back();
+        size_t n = b2.shape().back();
+        if (b2.shape()[b2.ndim() - 2] != k)
+            throw std::invalid_argument("matmul: inner dimensions do not match");
+
+        std::vector<size_t> batch = kernels::broadcast_shapes(
+            std::vector<size_t>(a2.shape().begin(), a2.shape().end() - 2),
+            std::vector<size_t>(b2.shape().begin(), b2.shape().end() - 2));
+        std::vector<size_t> a_shape = batch, b_shape = batch, out_shape = batch;
+        a_shape.insert(a_shape.end(), { m, k });
+        b_shape.insert(b_shape.end(), { k, n });
+        out_shape.insert(out_shape.end(), { m, n });
+        BasicTensor<T> ab = a2.broadcast_to(a_shape), bb = b2.broadcast_to(b_shape);
+        BasicTensor<T> out(out_shape, a.requires_grad() || b.requires_grad(), ir);
+
+        size_t batches = out.size() / std::max<size_t>(1, m * n);
+        size_t nd = batch.size();
+        const std::vector<size_t>& as = ab.stride();
+        const std::vector<size_t>& bs = bb.stride();
+        auto gemm_batch = [&](size_t index, size_t num_threads) {
+            // operand offsets of batch `index` (row-major over the batch dimensions)
+            size_t a_offset = 0, b_offset = 0;
+            for (size_t d = nd, rest = index; d-- > 0;) {
+                size_t i = rest % batch[d];
+                rest /= batch[d];
+                a_offset += i * as[d];
+                b_offset += i * bs[d];
+            }
+            kernels::gemm(m, n, k, ab.data() + a_offset, as[nd], as[nd + 1], bb.data() + b_offset, bs[nd], bs[nd + 1],
+                          out.data() + index * m * n, n, false, num_threads);
+        };
+
+        if (batches > 1 && 2. * double(m) * double(n) * double(k) < kernels::parallel_gemm_flops) {
+            // many small products: one thread per batch rather than threads within each product
+            size_t num_threads = out.size() * k >= kernels::parallel_elementwise_elements ? 0 : 1;
+            parallel::for_chunks(batches, num_threads, 0, [&](size_t, size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) gemm_batch(i, 1);
+            });
+        } else {
+            for (size_t i = 0; i < batches; ++i) gemm_batch(i, 0);
+        }
+
+        if (a.ndim() == 1 || b.ndim() == 1) {
+            std::vector<size_t> shape = batch;
+            if (a.ndim() != 1) shape.push_back(m);
+            if (b.ndim() != 1) shape.push_back(n);
+            return out.reshape(shape);
+        }
+        return out;
+    }
+
+    template<typename T>
+    std::pair<BasicTensor<T>, BasicTensor<T>> batched_matmul_backward(const BasicTensor<T>& grad, const BasicTensor<T>& a,
+                                                                      const BasicTensor<T>& b) {
+        // work on the matrix forms of the operands, as in `batched_matmul()`
+        BasicTensor<T> a2 = a.ndim() == 1 ? a.broadcast_to({ 1, a.size() }) : a;
+        BasicTensor<T> b2 = b.ndim() == 1 ? b.broadcast_to({ 1, b.size() }).t() : b;
+        size_t m = a2.shape()[a2.ndim() - 2], n = b2.shape().back();
+        std::vector<size_t> g_shape = kernels::broadcast_shapes(
+            std::vector<size_t>(a2.shape().begin(), a2.shape().end() - 2),
+            std::vector<size_t>(b2.shape().begin(), b2.shape().end() - 2));
+        g_shape.insert(g_shape.end(), { m, n });
+        BasicTensor<T> g = grad.reshape(g_shape);
+
+        size_t da = a2.ndim(), db = b2.ndim();
+        BasicTensor<T> grad_a = sum_to_shape(batched_matmul(g, b2.transpose(db - 2, db - 1), true), a2.shape());
+        BasicTensor<T> grad_b = sum_to_shape(batched_matmul(a2.transpose(da - 2, da - 1), g, true), b2.shape());
+        return { grad_a.reshape(a.shape()), grad_b.reshape(b.shape()) };
+    }
+
+    template<typename T>
+    BasicTensor<T> sum_to_shape(const BasicTensor<T>& grad, const std::vector<size_t>& shape) {
+        if (grad.shape() == shape) return grad;
+
+        BasicTensor<T> out = BasicTensor<T>::zeros(shape);
+        BasicTensor<T> g = grad.contiguous();
+        std::vector<size_t> out_stride = out.broadcast_to(g.shape()).stride();
+        if constexpr (std::is_same<grad_accum_t<T>, T>::value) {
+            kernels::sum_broadcast(g.shape(), g.data(), out.data(), out_stride);
+        } else {
+            std::vector<grad_accum_t<T>> sums(out.size());
+            kernels::sum_broadcast(g.shape(), g.data(), sums.data(), out_stride);
+            std::copy(sums.begin(), sums.end(), out.data());
+        }
+        return out;
+    }
+
+    std::vector<size_t> reduced_shape(const std::vector<size_t>& shape, const std::vector<size_t>& axes, bool keepdim) {
+        std::vector<bool> reduced(shape.size(), axes.empty());
+        for (size_t axis : axes) {
+            if (axis >= shape.size()) throw std::invalid_argument("reduce: axis out of range");
+            reduced[axis] = true;
+        }
+        std::vector<size_t> out;
+        for (size_t d = 0; d < shape.size(); ++d) {
+            if (!reduced[d]) out.push_back(shape[d]);
+            else if (keepdim) out.push_back(1);
+        }
+        return out;
+    }
+
+    namespace {
+        // View of `a` with the dimensions reduced over `axes` moved last, in their original
+        // order; `kept` gets the number of the other dimensions
+        template<typename T>
+        BasicTensor<T> reduced_last_(const BasicTensor<T>& a, const std::vector<size_t>& axes, size_t& kept) {
+            std::vector<bool> reduced(a.ndim(), axes.empty());
+            for (size_t axis : axes) reduced[axis] = true;
+            std::vector<size_t> dims;
+            for (size_t d = 0; d < a.ndim(); ++d)
+                if (!reduced[d]) dims.push_back(d);
+            kept = dims.size();
+            for (size_t d = 0; d < a.ndim(); ++d)
+                if (reduced[d]) dims.push_back(d);
+            return a.permute(dims);
+        }
+    } // namespace
+
+    template<typename T>
+    BasicTensor<T> reduce(const BasicTensor<T>& a, kernels::ReduceOp op, const std::vector<size_t>& axes, bool keepdim, bool ir) {
+        if (op == kernels::ReduceOp::argmax && !std::is_same<T, double>::value)
+            throw std::invalid_argument("reduce: float tensors cannot hold every index, use argmax_indices()");
+        std::vector<size_t> shape = reduced_shape(a.shape(), axes, keepdim);
+        size_t kept = 0;
+        BasicTensor<T> p = reduced_last_(a, axes, kept);
+        // indices are not differentiable
+        BasicTensor<T> out(shape, a.requires_grad() && op != kernels::ReduceOp::argmax, ir);
+        kernels::reduce(op, p.data(), p.shape(), p.stride(), kept, out.data());
+        return out;
+    }
+
+    template<typename T>
+    Tensor argmax_indices(const BasicTensor<T>& a, const std::vector<size_t>& axes, bool keepdim) {
+        std::vector<size_t> shape = reduced_shape(a.shape(), axes, keepdim);
+        size_t kept = 0;
+        BasicTensor<T> p = reduced_last_(a, axes, kept);
+        Tensor out(shape);
+        kernels::reduce(kernels::ReduceOp::argmax, p.data(), p.shape(), p.stride(), kept, out.data());
+        return out;
+    }
+
+    template struct BasicTensor<double>;
+    template struct BasicTensor<float>;
+
+#define NABLA_INSTANTIATE_TENSOR_FUNCTIONS(T) \
+    template std::ostream& operator<<(std::ostream& os, const BasicTensor<T>& tensor); \
+    template BasicTensor<T> batched_matmul(const BasicTensor<T>& a, const BasicTensor<T>& b, bool ir); \
+    template std::pair<BasicTensor<T>, BasicTensor<T>> batched_matmul_backward( \
+        const BasicTensor<T>& grad, const BasicTensor<T>& a, const BasicTensor<T>& b); \
+    template BasicTensor<T> sum_to_shape(const BasicTensor<T>& grad, const std::vector<size_t>& shape); \
+    template BasicTensor<T> reduce(const BasicTensor<T>& a, kernels::ReduceOp op, const std::vector<size_t>& axes, \
+                                   bool keepdim, bool ir); \
+    template Tensor argmax_indices(const BasicTensor<T>& a, const std::vector<size_t>& axes, bool keepdim);
+
+    NABLA_INSTANTIATE_TENSOR_FUNCTIONS(double)
+    NABLA_INSTANTIATE_TENSOR_FUNCTIONS(float)
+#undef NABLA_INSTANTIATE_TENSOR_FUNCTIONS
 } // namespace nabla
@@ -1,14 +1,20 @@
 #ifndef TENSOR_H
 #define TENSOR_H
 
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <stdexcept>
 #include <functional>
+#include <memory>
 #include <numeric> // std::accumulate
+#include <type_traits>
+#include <utility>
 
 #include "helpers.hpp"
+#include "tensor_alloc.hpp"
+#include "tensor_kernels.hpp"
 
 /* #include "gradient_tape.hpp" */
 
@@ -18,69 +24,183 @@ namespace nabla {
     // nabla::Tensor::rand(..., nabla::require_grad);
     constexpr bool require_grad = true;
 
-    struct Tensor {
+    // Reference-counted buffer holding the elements of a tensor. Views of a tensor (see
+    // `Tensor::reshape()`, `Tensor::at()`...) share the storage of the tensor they were taken from.
+    // Buffers are 64-byte aligned and come from the allocator installed with
+    // `memory::set_allocator()`, by default one caching freed buffers for reuse.
+    template<typename T>
+    using TensorStorage = std::vector<T, memory::StorageAllocator<T>>;
+
+    // Element type in which the gradients of tensors of element type `T` are accumulated (the
+    // `grad_` of a tensor and the sums of `sum_to_shape()`): always double, so that float tensors
+    // keep float64 gradient accumulation, unless the library is built with
+    // NABLA_NATIVE_GRAD_ACCUMULATION, in which case each type accumulates in its own precision.
+#ifdef NABLA_NATIVE_GRAD_ACCUMULATION
+    template<typename T>
+    using grad_accum_t = T;
+#else
+    template<typename T>
+    using grad_accum_t = double;
+#endif
+
+    template<typename T>
+    struct BasicTensor;
+    // float64 and float32 tensors
+    using Tensor = BasicTensor<double>;
+    using FloatTensor = BasicTensor<float>;
+
+    // A tensor is a view over a shared storage buffer: element (i0, ..., in) lives at
+    // `offset + i0 * stride[0] + ... + in * stride[n]` in the storage. Tensors created from a
+    // shape are contiguous (row-major strides and offset 0); views may have arbitrary strides.
+    // Copying a tensor is O(1) and shares its storage. The element type `T` is float or double
+    // (see the `Tensor` and `FloatTensor` aliases); tensors of different element types only mix
+    // through explicit conversions (`to()`).
+    template<typename T>
+    struct BasicTensor {
+        using value_type = T;
+
         // ir means a tensor is an intermediate representation, which shouldnt be pushed into the
         // computation graph, as it will be pushed later. NOTE: this is just a quick dirty fix.
         // Will think about a more convinient way to do this later
-        Tensor(const std::vector<size_t>& shape, bool requires_grad=false, bool ir=false);
-        Tensor(const std::string& name, const std::vector<size_t>& shape, bool requires_grad=false, bool ir=false);
-        Tensor() = default;
+        BasicTensor(const std::vector<size_t>& shape, bool requires_grad=false, bool ir=false);
+        BasicTensor(const std::string& name, const std::vector<size_t>& shape, bool requires_grad=false, bool ir=false);
+        BasicTensor() = default;
 
-        static Tensor rand(const std::vector<size_t>& shape, bool grad=false);
-        static Tensor zeros(const std::vector<size_t>& shape, bool grad=false);
-        static Tensor ones(const std::vector<size_t>& shape, bool grad=false);
+        static BasicTensor rand(const std::vector<size_t>& shape, bool grad=false);
+        static BasicTensor zeros(const std::vector<size_t>& shape, bool grad=false);
+        static BasicTensor ones(const std::vector<size_t>& shape, bool grad=false);
 
-        double& at(const std::vector<size_t>& indices);
-        const double& at(const std::vector<size_t>& indices) const;
+        T& at(const std::vector<size_t>& indices);
+        const T& at(const std::vector<size_t>& indices) const;
 
-        Tensor at(size_t index, size_t dim=0) const;
+        // View of the subtensor at position `index` of dimension `dim` (which is dropped)
+        BasicTensor at(size_t index, size_t dim=0) const;
 
-        Tensor t() const;
+        // View with the dimensions reordered: dimension `i` of the result is dimension `dims[i]`
+        // of this tensor. No data is moved; call `contiguous()` to materialize the new layout.
+        BasicTensor permute(const std::vector<size_t>& dims) const;
+        // View with dimensions `dim0` and `dim1` swapped
+        BasicTensor transpose(size_t dim0, size_t dim1) const;
+        // View with the order of all dimensions reversed (the matrix transpose for 2-d tensors)
+        BasicTensor t() const;
+        // View of the tensor broadcast to `shape` (NumPy rules): missing leading dimensions and
+        // dimensions of size 1 are repeated with stride 0, without copying any element.
+        BasicTensor broadcast_to(const std::vector<size_t>& shape) const;
 
         const std::string& name() const { return name_; }
         const std::vector<size_t>& shape() const { return shape_; }
         size_t ndim() const { return shape_.size(); }
         const std::vector<size_t>& stride() const { return stride_; }
-        const std::vector<double>& data() const { return data_; }
+        size_t offset() const { return offset_; }
         bool requires_grad() const { return requires_grad_; }
         size_t size() const { return size_; }
         bool is_leaf() const { return is_leaf_; }
 
-        Tensor flatten() {
-            Tensor flat_tensor({data_.size()}, requires_grad_);
-            flat_tensor.data_ = data_;
-            return flat_tensor;
+        // Pointer to the first element of the tensor in its storage. Elements are laid out
+        // according to `stride()`, which is row-major only if the tensor `is_contiguous()`.
+        const T* data() const { return storage_ ? storage_->data() + offset_ : nullptr; }
+        T* data() { return storage_ ? storage_->data() + offset_ : nullptr; }
+
+        // Whether the elements are laid out in row-major order without gaps
+        bool is_contiguous() const;
+        // This tensor if it is contiguous, otherwise a contiguous copy of it (made with the
+        // blocked kernel in `tensor_kernels.hpp`)
+        BasicTensor contiguous() const;
+        // Whether both tensors are views of the same storage
+        bool shares_storage(const BasicTensor& other) const { return storage_ && storage_ == other.storage_; }
+
+        // View of the tensor with the given shape (same number of elements). Contiguous tensors
+        // are reshaped in O(1); other tensors are materialized with `contiguous()` first.
+        BasicTensor reshape(const std::vector<size_t>& shape) const;
+        BasicTensor flatten() const { return reshape({ size_ }); }
+
+        // Copy of the tensor with elements of type `U` (this tensor itself if `U` is `T`)
+        template<typename U>
+        BasicTensor<U> to() const {
+            if constexpr (std::is_same<U, T>::value) {
+                return *this;
+            } else {
+                BasicTensor<U> out(shape_, requires_grad_);
+                BasicTensor src = contiguous();
+                std::copy(src.data(), src.data() + size_, out.data());
+                return out;
+            }
         }
+        template<typename U>
+        explicit operator BasicTensor<U>() const { return to<U>(); }
 
-        std::vector<double> raw_data() const { return data_; }
-        void setdata(std::vector<double> v) { data_ = v; }
+        // Copy of the elements in row-major order
+        std::vector<T> raw_data() const;
+        // Replace the elements of the tensor, given in row-major order. The tensor gets a fresh
+        // contiguous storage, other views of the previous storage are left untouched.
+        void setdata(std::vector<T> v);
 
-        // Apply the given transformation to the tensor elementwise.
-        Tensor apply_transform(std::function<double(double)> transformation) const;
+        // Apply the given transformation to the tensor elementwise. `transformation` can be any
+        // callable taking and returning a T; it is inlined into the loop. The common math
+        // functions have vectorized kernels, see `map_unary()`.
+        template<typename F>
+        BasicTensor apply_transform(F transformation) const {
+            BasicTensor tens(shape_, requires_grad_);
+            const T* src = data();
+            T* dst = tens.data();
+            if (is_contiguous()) {
+                for (size_t i = 0; i < size_; ++i) dst[i] = transformation(src[i]);
+            } else {
+                for_each_offset([&](size_t offset) { *dst++ = transformation(src[offset]); });
+            }
+            return tens;
+        }
         void backward() const;
 
-        friend std::ostream& operator<<(std::ostream& os, const Tensor& tensor);
+        // Call `fn(storage_offset)` for every element of the tensor in row-major order, where
+        // `storage_offset` is relative to `data()`.
+        template<typename F>
+        void for_each_offset(F fn) const {
+            if (size_ == 0) return;
+            if (is_contiguous()) {
+                for (size_t i = 0; i < size_; ++i) fn(i);
+                return;
+            }
+            std::vector<size_t> index(shape_.size(), 0);
+            size_t offset = 0;
+            for (size_t n = 0; n < size_; ++n) {
+                fn(offset);
+                // odometer increment of the multi-index, innermost dimension first
+                for (size_t d = shape_.size(); d-- > 0;) {
+                    offset += stride_[d];
+                    if (++index[d] < shape_[d]) break;
+                    offset -= stride_[d] * shape_[d];
+                    index[d] = 0;
+                }
+            }
+        }
+
+        template<typename U>
+        friend std::ostream& operator<<(std::ostream& os, const BasicTensor<U>& tensor);
 
         size_t cg_node_idx_ = -1; // index of the tensor in the computation graph
         bool is_leaf_ = false;
-        std::vector<double> grad_;
+        std::vector<grad_accum_t<T>> grad_;
     private:
+        // View of the storage of this tensor with the given layout, not pushed to the graph
+        BasicTensor _view_(std::vector<size_t> shape, std::vector<size_t> stride, size_t offset) const;
+
         std::string _generate_default_name_();
         std::vector<size_t> _compute_stride_from_shape_(const std::vector<size_t>& shape) const;
 
         // Given a set of indices referring to a position shaped tensor data, compute the
-        // corresponding index in the plain internal 'data_' vector.
+        // corresponding offset from `data()` in the storage.
         size_t _flatten_index_(const std::vector<size_t>& indices) const;
 
         // Convert internal tensor data into a string representation according to its shape.
-        // 'index0' represents the begin index of the current chunk of data being processed.
-        // 'dim' is the current dimension (i.e. element of Tensor::shape_) which is being processed.
+        // 'offset0' represents the storage offset of the current chunk of data being processed.
+        // 'dim' is the current dimension (i.e. element of BasicTensor::shape_) which is being processed.
         // Both default to 0 and are passed down the recursion.
-        std::string _data_to_string_(size_t index0=0, size_t dim=0) const;
+        std::string _data_to_string_(size_t offset0=0, size_t dim=0) const;
 
         template<typename X>
-        std::vector<double> flatten_vec_(const std::vector<X>& vec) {
-            std::vector<double> f;
+        std::vector<T> flatten_vec_(const std::vector<X>& vec) {
+            std::vector<T> f;
             flatten_helper(vec, f);
             return f;
         }
@@ -88,13 +208,77 @@ namespace nabla {
         std::string name_;
         std::vector<size_t> shape_;
         std::vector<size_t> stride_;
-        std::vector<double> data_;
-        size_t size_;
-        bool requires_grad_;
-
+        std::shared_ptr<TensorStorage<T>> storage_;
+        size_t offset_ = 0;
+        size_t size_ = 0;
+        bool requires_grad_ = false;
 
-        static inline int tensor_next_id_ = 0;
     };
+
+    // Elementwise `op(a, b)` over the broadcast shape of `a` and `b` (see
+    // `kernels::broadcast_shapes()`). Operands may be strided views; broadcast operands are
+    // never materialized. `ir` is forwarded to the constructor of the result.
+    template<typename T, typename Op>
+    BasicTensor<T> map_binary(const BasicTensor<T>& a, const BasicTensor<T>& b, Op op, bool ir=false) {
+        std::vector<size_t> shape = kernels::broadcast_shapes(a.shape(), b.shape());
+        BasicTensor<T> out(shape, a.requires_grad() || b.requires_grad(), ir);
+        BasicTensor<T> ab = a.broadcast_to(shape), bb = b.broadcast_to(shape);
+        kernels::binary_map(shape, ab.data(), ab.stride(), bb.data(), bb.stride(), out.data(), op);
+        return out;
+    }
+
+    // Matrix product following NumPy's `matmul`: for tensors of at least 2 dimensions the last
+    // two are multiplied ([..., m, k] x [..., k, n] -> [..., m, n]) and the leading (batch)
+    // dimensions broadcast; a 1-d `a` is taken as a row vector and a 1-d `b` as a column vector,
+    // the corresponding dimension being removed from the result. Operands may be strided views
+    // (e.g. `t()`), which the GEMM kernel packs without a copy. Throws std::invalid_argument on
+    // 0-d operands or mismatched inner dimensions. `ir` is forwarded to the constructor of the
+    // result. See `nabla::matmul()` for the graph-recorded operator.
+    template<typename T>
+    BasicTensor<T> batched_matmul(const BasicTensor<T>& a, const BasicTensor<T>& b, bool ir=false);
+
+    // Gradients of `batched_matmul(a, b)` with respect to `a` and `b` given the gradient `grad`
+    // of its result: grad x b^T and a^T x grad, computed by `batched_matmul()` on transposed
+    // views and summed over broadcast batch dimensions.
+    template<typename T>
+    std::pair<BasicTensor<T>, BasicTensor<T>> batched_matmul_backward(const BasicTensor<T>& grad, const BasicTensor<T>& a,
+                                                                      const BasicTensor<T>& b);
+
+    // Sum `grad` over the dimensions along which a tensor of shape `shape` was broadcast to
+    // produce it, i.e. the gradient of `x.broadcast_to(grad.shape())` with respect to `x`. The
+    // sums are accumulated in `grad_accum_t<T>`.
+    template<typename T>
+    BasicTensor<T> sum_to_shape(const BasicTensor<T>& grad, const std::vector<size_t>& shape);
+
+    // Shape of the result of reducing a tensor of shape `shape` over `axes` (all dimensions when
+    // empty): the reduced dimensions are removed, or kept with size 1 if `keepdim`. Throws
+    // std::invalid_argument on out-of-range axes.
+    std::vector<size_t> reduced_shape(const std::vector<size_t>& shape, const std::vector<size_t>& axes, bool keepdim);
+
+    // Reduce `a` over `axes` (all dimensions when empty; order and repetitions do not matter)
+    // with the kernel of `kernels::reduce()`, see `reduced_shape()` for the shape of the result.
+    // Strided views are reduced in place when the reduced or the kept dimensions are contiguous.
+    // `ir` is forwarded to the constructor of the result. Throws std::invalid_argument for
+    // `argmax` on float tensors, see `argmax_indices()`.
+    template<typename T>
+    BasicTensor<T> reduce(const BasicTensor<T>& a, kernels::ReduceOp op, const std::vector<size_t>& axes,
+                          bool keepdim=false, bool ir=false);
+
+    // `reduce(a, kernels::ReduceOp::argmax, axes, keepdim)` with the indices held in a float64
+    // tensor whatever the element type of `a`, so that they are exact for any reduced extent
+    // (float only represents integers up to 2^24). Not recorded in the computation graph.
+    template<typename T>
+    Tensor argmax_indices(const BasicTensor<T>& a, const std::vector<size_t>& axes={}, bool keepdim=false);
+
+    // Elementwise `fn` on the vectorized kernels of `kernels::unary_map()`. `ir` is forwarded to
+    // the constructor of the result.
+    template<typename T>
+    BasicTensor<T> map_unary(const BasicTensor<T>& a, kernels::UnaryFn fn, bool ir=false) {
+        BasicTensor<T> src = a.contiguous();
+        BasicTensor<T> out(a.shape(), a.requires_grad(), ir);
+        kernels::unary_map(fn, src.data(), out.data(), out.size());
+        return out;
+    }
 } // namespace nabla
 
 #endif // TENSOR_H
@@ -0,0 +1,290 @@
+#include "tensor_alloc.hpp"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace nabla {
+    namespace memory {
+        namespace {
+            void* system_allocate_(size_t bytes) { return ::operator new(bytes, std::align_val_t(alignment)); }
+            void system_deallocate_(void* p) noexcept { ::operator delete(p, std::align_val_t(alignment)); }
+
+            // Size classes of `CachingAllocator`: 64, 128, 192, 256 bytes, then 4 classes in each
+            // (2^k, 2^(k+1)] for k >= 8, up to `max_block_bytes`
+            constexpr size_t small_classes = 4;
+            constexpr size_t min_class_log2 = 8;
+            constexpr size_t num_classes = small_classes + 4 * (30 - min_class_log2);
+            static_assert(CachingAllocator::max_block_bytes == size_t(1) << 30, "size classes end at 1 GiB");
+
+            size_t class_index_(size_t bytes) {
+                if (bytes <= 64 * small_classes) return bytes == 0 ? 0 : (bytes - 1) / 64;
+                size_t k = min_class_log2; // bytes is in (2^k, 2^(k+1)]
+                while ((size_t(1) << (k + 1)) < bytes) ++k;
+                return small_classes + 4 * (k - min_class_log2) + ((bytes - 1 - (size_t(1) << k)) >> (k - 2));
+            }
+
+            size_t class_bytes_(size_t index) {
+                if (index < small_classes) return 64 * (index + 1);
+                size_t k = min_class_log2 + (index - small_classes) / 4;
+                return (size_t(1) << k) + ((index - small_classes) % 4 + 1) * (size_t(1) << (k - 2));
+            }
+
+            using FreeLists = std::array<std::vector<void*>, num_classes>;
+
+            void increase_(std::atomic<uint64_t>& counter, uint64_t value) { counter.fetch_add(value, std::memory_order_relaxed); }
+            void decrease_(std::atomic<uint64_t>& counter, uint64_t value) { counter.fetch_sub(value, std::memory_order_relaxed); }
+        } // namespace
+
+        void* SystemAllocator::allocate(size_t bytes) {
+            void* p = system_allocate_(bytes);
+            increase_(this->m_allocations, 1);
+            increase_(this->m_bytes_in_use, bytes);
+            return p;
+        }
+
+        void SystemAllocator::deallocate(void* p, size_t bytes) noexcept {
+            system_deallocate_(p);
+            increase_(this->m_deallocations, 1);
+            decrease_(this->m_bytes_in_use, bytes);
+        }
+
+        AllocatorStats SystemAllocator::stats() const {
+            AllocatorStats s;
+            s.allocations = this->m_allocations.load(std::memory_order_relaxed);
+            s.deallocations = this->m_deallocations.load(std::memory_order_relaxed);
+            s.bytes_in_use = this->m_bytes_in_use.load(std::memory_order_relaxed);
+            return s;
+        }
+
+        // State shared by a caching allocator and the thread caches holding its blocks, which
+        // keep it alive until they have been emptied
+        struct CachingAllocator::Pool {
+            Pool(size_t max_cached_bytes, size_t thread_cache_bytes)
+                : max_cached_bytes{max_cached_bytes}, thread_cache_bytes{thread_cache_bytes} {}
+
+            ~Pool() {
+                for (auto& blocks : this->free)
+                    for (void* p : blocks) system_deallocate_(p);
+            }
+
+            // Keep a free block in the shared pool, or return it to the system when full
+            void put(void* p, size_t index) {
+                size_t bytes = class_bytes_(index);
+                {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    if (this->free_bytes + bytes <= this->max_cached_bytes) {
+                        try {
+                            this->free[index].push_back(p);
+                            this->free_bytes += bytes;
+                            return;
+                        } catch (const std::bad_alloc&) {
+                            // no room to record the block: free it
+                        }
+                    }
+                }
+                decrease_(this->bytes_cached, bytes);
+                system_deallocate_(p);
+            }
+
+            void* take(size_t index) {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                std::vector<void*>& blocks = this->free[index];
+                if (blocks.empty()) return nullptr;
+                void* p = blocks.back();
+                blocks.pop_back();
+                this->free_bytes -= class_bytes_(index);
+                return p;
+            }
+
+            // Return every block of the shared pool to the system
+            void release() {
+                FreeLists blocks;
+                {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    blocks.swap(this->free);
+                    this->free_bytes = 0;
+                }
+                for (size_t index = 0; index < num_classes; ++index) {
+                    for (void* p : blocks[index]) system_deallocate_(p);
+                    decrease_(this->bytes_cached, blocks[index].size() * class_bytes_(index));
+                }
+            }
+
+            const size_t max_cached_bytes;
+            const size_t thread_cache_bytes;
+
+            std::mutex mutex;
+            FreeLists free;        // guarded by `mutex`
+            size_t free_bytes = 0; // guarded by `mutex`
+
+            std::atomic<uint64_t> allocations{0}, hits{0}, deallocations{0}, bytes_in_use{0};
+            std::atomic<uint64_t> bytes_cached{0}; // in the shared pool and in thread caches
+        };
+
+        namespace {
+            // Free blocks of one caching allocator kept by one thread
+            struct ThreadCache {
+                explicit ThreadCache(std::shared_ptr<CachingAllocator::Pool> pool) : pool{std::move(pool)} {}
+
+                // Hand the blocks over to the shared pool
+                ~ThreadCache() {
+                    for (size_t index = 0; index < num_classes; ++index)
+                        for (void* p : this->free[index]) this->pool->put(p, index);
+                }
+
+                // Return the blocks to the system
+                void release() {
+                    for (size_t index = 0; index < num_classes; ++index) {
+                        for (void* p : this->free[index]) system_deallocate_(p);
+                        decrease_(this->pool->bytes_cached, this->free[index].size() * class_bytes_(index));
+                        this->free[index].clear();
+                    }
+                    this->free_bytes = 0;
+                }
+
+                std::shared_ptr<CachingAllocator::Pool> pool;
+                FreeLists free;
+                size_t free_bytes = 0;
+            };
+
+            // Caches of the calling thread, one per caching allocator it freed blocks to (there is
+            // usually a single one). Once they are destroyed at thread exit, buffers freed by the
+            // destructors that run later (e.g. of static tensors) go to the shared pools directly.
+            thread_local bool thread_caches_destroyed = false;
+            struct ThreadCaches {
+                ~ThreadCaches() {
+                    this->caches.clear();
+                    thread_caches_destroyed = true;
+                }
+                std::vector<std::unique_ptr<ThreadCache>> caches;
+            };
+            thread_local ThreadCaches thread_caches;
+
+            ThreadCache* thread_cache_(const std::shared_ptr<CachingAllocator::Pool>& pool) {
+                if (thread_caches_destroyed) return nullptr;
+                for (auto& cache : thread_caches.caches)
+                    if (cache->pool == pool) return cache.get();
+                thread_caches.caches.push_back(std::make_unique<ThreadCache>(pool));
+                return thread_caches.caches.back().get();
+            }
+        } // namespace
+
+        CachingAllocator::CachingAllocator(size_t max_cached_bytes, size_t thread_cache_bytes)
+            : m_pool{std::make_shared<Pool>(max_cached_bytes, thread_cache_bytes)} {}
+
+        CachingAllocator::~CachingAllocator() {
+            // the caches of other threads are handed to the pool, which is freed with the last one
+            if (thread_caches_destroyed) return;
+            std::vector<std::unique_ptr<ThreadCache>>& caches = thread_caches.caches;
+            for (auto it = caches.begin(); it != caches.end(); ++it) {
+                if ((*it)->pool == this->m_pool) {
+                    (*it)->release();
+                    caches.erase(it);
+                    break;
+                }
+            }
+        }
+
+        void* CachingAllocator::allocate(size_t bytes) {
+            Pool& pool = *this->m_pool;
+            increase_(pool.allocations, 1);
+            if (bytes > max_block_bytes) {
+                void* p = system_allocate_(bytes);
+                increase_(pool.bytes_in_use, bytes);
+                return p;
+            }
+
+            size_t index = class_index_(bytes);
+            size_t block_bytes = class_bytes_(index);
+            ThreadCache* cache = thread_cache_(this->m_pool);
+            void* p = nullptr;
+            if (cache && !cache->free[index].empty()) {
+                p = cache->free[index].back();
+                cache->free[index].pop_back();
+                cache->free_bytes -= block_bytes;
+            } else {
+                p = pool.take(index);
+            }
+
+            if (p) {
+                increase_(pool.hits, 1);
+                decrease_(pool.bytes_cached, block_bytes);
+            } else {
+                try {
+                    p = system_allocate_(block_bytes);
+                } catch (const std::bad_alloc&) {
+                    this->release(); // the cached blocks may be of other classes
+                    p = system_allocate_(block_bytes);
+                }
+            }
+            increase_(pool.bytes_in_use, block_bytes);
+            return p;
+        }
+
+        void CachingAllocator::deallocate(void* p, size_t bytes) noexcept {
+            Pool& pool = *this->m_pool;
+            increase_(pool.deallocations, 1);
+            if (bytes > max_block_bytes) {
+                decrease_(pool.bytes_in_use, bytes);
+                system_deallocate_(p);
+                return;
+            }
+
+            size_t index = class_index_(bytes);
+            size_t block_bytes = class_bytes_(index);
+            decrease_(pool.bytes_in_use, block_bytes);
+            increase_(pool.bytes_cached, block_bytes);
+            try {
+                ThreadCache* cache = thread_cache_(this->m_pool);
+                if (cache && cache->free_bytes + block_bytes <= pool.thread_cache_bytes) {
+                    cache->free[index].push_back(p);
+                    cache->free_bytes += block_bytes;
+                    return;
+                }
+            } catch (const std::bad_alloc&) {
+                // no room to record the block in the thread cache: fall through to the pool
+            }
+            pool.put(p, index);
+        }
+
+        AllocatorStats CachingAllocator::stats() const {
+            const Pool& pool = *this->m_pool;
+            AllocatorStats s;
+            s.allocations = pool.allocations.load(std::memory_order_relaxed);
+            s.hits = pool.hits.load(std::memory_order_relaxed);
+            s.deallocations = pool.deallocations.load(std::memory_order_relaxed);
+            s.bytes_in_use = pool.bytes_in_use.load(std::memory_order_relaxed);
+            s.bytes_cached = pool.bytes_cached.load(std::memory_order_relaxed);
+            return s;
+        }
+
+        void CachingAllocator::release() {
+            if (ThreadCache* cache = thread_cache_(this->m_pool)) cache->release();
+            this->m_pool->release();
+        }
+
+        SystemAllocator& system_allocator() {
+            static SystemAllocator* allocator = new SystemAllocator();
+            return *allocator;
+        }
+
+        CachingAllocator& caching_allocator() {
+            static CachingAllocator* allocator = new CachingAllocator();
+            return *allocator;
+        }
+
+        namespace {
+            std::atomic<Allocator*>& current_allocator_() {
+                static std::atomic<Allocator*> current{&caching_allocator()};
+                return current;
+            }
+        } // namespace
+
+        Allocator& get_allocator() { return *current_allocator_().load(std::memory_order_acquire); }
+
+        void set_allocator(Allocator& allocator) { current_allocator_().store(&allocator, std::memory_order_release); }
+    } // namespace memory
+} // namespace nabla
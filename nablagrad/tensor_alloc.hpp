@@ -0,0 +1,114 @@
+#ifndef TENSOR_ALLOC_H
+#define TENSOR_ALLOC_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace nabla {
+    // Allocators of tensor element buffers. Every tensor storage is allocated through the
+    // allocator installed when it was created (see `set_allocator()`) and returned to that same
+    // allocator when its last view is destroyed, so an allocator must outlive the tensors it
+    // allocated. The default is the process-wide `caching_allocator()`.
+    namespace memory {
+        // Alignment of every buffer handed out, a cache line: SIMD loads never split lines
+        constexpr size_t alignment = 64;
+
+        struct AllocatorStats {
+            uint64_t allocations = 0;   // calls to `allocate()`
+            uint64_t hits = 0;          // allocations served from cached blocks
+            uint64_t deallocations = 0;
+            uint64_t bytes_in_use = 0;  // held by live buffers, rounded up to their size class
+            uint64_t bytes_cached = 0;  // held by free blocks kept for reuse
+
+            double hit_rate() const { return allocations == 0 ? 0. : double(hits) / double(allocations); }
+        };
+
+        struct Allocator {
+            virtual ~Allocator() = default;
+            // Buffer of at least `bytes` bytes aligned to `alignment`; throws std::bad_alloc
+            virtual void* allocate(size_t bytes) = 0;
+            // Return a buffer obtained from `allocate(bytes)` with the same `bytes`
+            virtual void deallocate(void* p, size_t bytes) noexcept = 0;
+            virtual AllocatorStats stats() const = 0;
+        };
+
+        // Aligned operator new / delete on every call
+        struct SystemAllocator : Allocator {
+            void* allocate(size_t bytes) override;
+            void deallocate(void* p, size_t bytes) noexcept override;
+            AllocatorStats stats() const override;
+
+        private:
+            std::atomic<uint64_t> m_allocations{0}, m_deallocations{0}, m_bytes_in_use{0};
+        };
+
+        // Keeps freed buffers for reuse instead of returning them to the system. Requests are
+        // rounded up to a size class: multiples of 64 bytes up to 256 bytes, then four classes per
+        // power of two (at most 25% of a block is wasted). Freed blocks go to a cache owned by the
+        // calling thread, which serves its next allocations of the same class without locking;
+        // past `thread_cache_bytes` per thread they go to a pool shared by all threads, which
+        // keeps up to `max_cached_bytes` and returns the rest to the system. A thread's cache is
+        // moved to the shared pool when the thread exits. Requests above the largest class
+        // (`max_block_bytes`) are not cached.
+        struct CachingAllocator : Allocator {
+            static constexpr size_t max_block_bytes = size_t(1) << 30;
+
+            explicit CachingAllocator(size_t max_cached_bytes = size_t(1) << 30,
+                                      size_t thread_cache_bytes = size_t(64) << 20);
+            ~CachingAllocator() override;
+
+            CachingAllocator(const CachingAllocator&) = delete;
+            CachingAllocator& operator=(const CachingAllocator&) = delete;
+
+            void* allocate(size_t bytes) override;
+            void deallocate(void* p, size_t bytes) noexcept override;
+            AllocatorStats stats() const override;
+
+            // Return the blocks cached by the shared pool and by the calling thread to the system
+            void release();
+
+            struct Pool;
+
+        private:
+            std::shared_ptr<Pool> m_pool;
+        };
+
+        // Process-wide instances, never destroyed (tensors may outlive static objects)
+        SystemAllocator& system_allocator();
+        CachingAllocator& caching_allocator();
+
+        // Allocator used by the tensors created from now on, by any thread; tensors already
+        // created keep the allocator of their storage.
+        Allocator& get_allocator();
+        void set_allocator(Allocator& allocator);
+
+        // Standard allocator adaptor binding container storage to an `Allocator`, captured at
+        // construction: the one installed by `set_allocator()` by default.
+        template<typename T>
+        struct StorageAllocator {
+            using value_type = T;
+
+            StorageAllocator() noexcept : m_allocator{&get_allocator()} {}
+            explicit StorageAllocator(Allocator& allocator) noexcept : m_allocator{&allocator} {}
+            template<typename U>
+            StorageAllocator(const StorageAllocator<U>& other) noexcept : m_allocator{&other.allocator()} {}
+
+            T* allocate(size_t n) { return static_cast<T*>(this->m_allocator->allocate(n * sizeof(T))); }
+            void deallocate(T* p, size_t n) noexcept { this->m_allocator->deallocate(p, n * sizeof(T)); }
+
+            Allocator& allocator() const noexcept { return *this->m_allocator; }
+
+            template<typename U>
+            bool operator==(const StorageAllocator<U>& other) const noexcept { return this->m_allocator == &other.allocator(); }
+            template<typename U>
+            bool operator!=(const StorageAllocator<U>& other) const noexcept { return !(*this == other); }
+
+        private:
+            Allocator* m_allocator;
+        };
+    } // namespace memory
+} // namespace nabla
+
+#endif
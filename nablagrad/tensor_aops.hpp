@@ -6,42 +6,182 @@
 
 #include <cstdlib>
 #include <functional>
-#include <execution>
 #include <cmath>
 #include <algorithm>
 #include <memory>
 
 namespace nabla {
 
-    // Backward pass for the `nabla::add()` tensor operator
-    Tensor add_backward(const Tensor& self, const Tensor& other) {
-        return Tensor::ones({2, self.size()});
+    template<typename T>
+    BasicTensor<T> add(const BasicTensor<T>& self, const BasicTensor<T>& other) {
+        ta_ops::TensorAdd<T> add_op(self, other);
+        BasicTensor<T> out = add_op.forward();
+        autograd::ComputationGraph<T>::push_operator(add_op, out);
+        return out;
+    }
+
+    template<typename T>
+    BasicTensor<T> sub(const BasicTensor<T>& self, const BasicTensor<T>& other) {
+        ta_ops::TensorSub<T> sub_op(self, other);
+        BasicTensor<T> out = sub_op.forward();
+        autograd::ComputationGraph<T>::push_operator(sub_op, out);
+        return out;
+    }
+
+    template<typename T>
+    BasicTensor<T> mul(const BasicTensor<T>& self, const BasicTensor<T>& other) {
+        ta_ops::TensorMul<T> mul_op(self, other);
+        BasicTensor<T> out = mul_op.forward();
+        autograd::ComputationGraph<T>::push_operator(mul_op, out);
+        return out;
+    }
+
+    template<typename T>
+    BasicTensor<T> div(const BasicTensor<T>& self, const BasicTensor<T>& other) {
+        ta_ops::TensorDiv<T> div_op(self, other);
+        BasicTensor<T> out = div_op.forward();
+        autograd::ComputationGraph<T>::push_operator(div_op, out);
+        return out;
+    }
+
+    // Backward passes of the binary operators: given the gradient `grad` of the (broadcast)
+    // output, return the gradients of `self` and `other`, reduced back to their shapes.
+    template<typename T>
+    std::pair<BasicTensor<T>, BasicTensor<T>> add_backward(const BasicTensor<T>& grad, const BasicTensor<T>& self,
+                                                           const BasicTensor<T>& other) {
+        return ta_ops::TensorAdd<T>(self, other).backward(grad);
+    }
+
+    template<typename T>
+    std::pair<BasicTensor<T>, BasicTensor<T>> sub_backward(const BasicTensor<T>& grad, const BasicTensor<T>& self,
+                                                           const BasicTensor<T>& other) {
+        return ta_ops::TensorSub<T>(self, other).backward(grad);
+    }
+
+    template<typename T>
+    std::pair<BasicTensor<T>, BasicTensor<T>> mul_backward(const BasicTensor<T>& grad, const BasicTensor<T>& self,
+                                                           const BasicTensor<T>& other) {
+        return ta_ops::TensorMul<T>(self, other).backward(grad);
+    }
+
+    template<typename T>
+    std::pair<BasicTensor<T>, BasicTensor<T>> div_backward(const BasicTensor<T>& grad, const BasicTensor<T>& self,
+                                                           const BasicTensor<T>& other) {
+        return ta_ops::TensorDiv<T>(self, other).backward(grad);
+    }
+
+    // Matrix product with NumPy `matmul` semantics (see `batched_matmul()`), recorded in the
+    // computation graph
+    template<typename T>
+    BasicTensor<T> matmul(const BasicTensor<T>& self, const BasicTensor<T>& other) {
+        ta_ops::TensorMatMul<T> matmul_op(self, other);
+        BasicTensor<T> out = matmul_op.forward();
+        autograd::ComputationGraph<T>::push_operator(matmul_op, out);
+        return out;
+    }
+
+    template<typename T>
+    std::pair<BasicTensor<T>, BasicTensor<T>> matmul_backward(const BasicTensor<T>& grad, const BasicTensor<T>& self,
+                                                              const BasicTensor<T>& other) {
+        return batched_matmul_backward(grad, self, other);
+    }
+
+    template<typename T>
+    BasicTensor<T> sin(const BasicTensor<T>& tensor) { return map_unary(tensor, kernels::UnaryFn::sin); }
+    template<typename T>
+    BasicTensor<T> cos(const BasicTensor<T>& tensor) { return map_unary(tensor, kernels::UnaryFn::cos); }
+    template<typename T>
+    BasicTensor<T> tan(const BasicTensor<T>& tensor) { return tensor.apply_transform([](T x) { return std::tan(x); }); }
+    template<typename T>
+    BasicTensor<T> log(const BasicTensor<T>& tensor) { return map_unary(tensor, kernels::UnaryFn::log); }
+    template<typename T>
+    BasicTensor<T> exp(const BasicTensor<T>& tensor) { return map_unary(tensor, kernels::UnaryFn::exp); }
+    template<typename T>
+    BasicTensor<T> tanh(const BasicTensor<T>& tensor) { return map_unary(tensor, kernels::UnaryFn::tanh); }
+
+    // Reductions over `axes` (all dimensions when empty), dropping the reduced dimensions unless
+    // `keepdim` (see `reduce()`), recorded in the computation graph
+    template<typename T>
+    BasicTensor<T> sum(const BasicTensor<T>& self, const std::vector<size_t>& axes={}, bool keepdim=false) {
+        ta_ops::TensorSum<T> sum_op(self, axes, keepdim);
+        BasicTensor<T> out = sum_op.forward();
+        autograd::ComputationGraph<T>::push_operator(sum_op, out);
+        return out;
+    }
+
+    template<typename T>
+    BasicTensor<T> mean(const BasicTensor<T>& self, const std::vector<size_t>& axes={}, bool keepdim=false) {
+        ta_ops::TensorMean<T> mean_op(self, axes, keepdim);
+        BasicTensor<T> out = mean_op.forward();
+        autograd::ComputationGraph<T>::push_operator(mean_op, out);
+        return out;
+    }
+
+    // NaN propagates: the maximum of elements including a NaN is NaN
+    template<typename T>
+    BasicTensor<T> max(const BasicTensor<T>& self, const std::vector<size_t>& axes={}, bool keepdim=false) {
+        ta_ops::TensorMax<T> max_op(self, axes, keepdim);
+        BasicTensor<T> out = max_op.forward();
+        autograd::ComputationGraph<T>::push_operator(max_op, out);
+        return out;
     }
 
-    Tensor add(const Tensor& self, const Tensor& other) {
-        if (self.shape() != other.shape()) {
-            std::cerr << "add: shapes of tensors differ" << std::endl;
-        }
+    // Row-major index, over the reduced dimensions, of the first maximum (or first NaN). The
+    // indices are returned in a float64 tensor whatever the element type, which holds them
+    // exactly, and are not differentiable, so nothing is recorded.
+    template<typename T>
+    Tensor argmax(const BasicTensor<T>& self, const std::vector<size_t>& axes={}, bool keepdim=false) {
+        return argmax_indices(self, axes, keepdim);
+    }
+
+    // log(sum(exp(x))), computed as m + log(sum(exp(x - m))) with m the maximum so that exp
+    // cannot overflow
+    template<typename T>
+    BasicTensor<T> logsumexp(const BasicTensor<T>& self, const std::vector<size_t>& axes={}, bool keepdim=false) {
+        ta_ops::TensorLogSumExp<T> logsumexp_op(self, axes, keepdim);
+        BasicTensor<T> out = logsumexp_op.forward();
+        autograd::ComputationGraph<T>::push_operator(logsumexp_op, out);
+        return out;
+    }
 
-        ta_ops::TensorAdd add_op(self, other);
-        Tensor out = add_op.forward();
-        autograd::ComputationGraph::push_operator(add_op, out);
+    // Euclidean (Frobenius) norm
+    template<typename T>
+    BasicTensor<T> norm(const BasicTensor<T>& self, const std::vector<size_t>& axes={}, bool keepdim=false) {
+        ta_ops::TensorNorm<T> norm_op(self, axes, keepdim);
+        BasicTensor<T> out = norm_op.forward();
+        autograd::ComputationGraph<T>::push_operator(norm_op, out);
         return out;
     }
 
-    Tensor mul(const Tensor& self, const Tensor& other) {
-        Tensor add_tensor(self.shape(), self.requires_grad() || other.requires_grad());
-        std::vector<double> res(self.raw_data());
-        std::transform(res.begin(), res.end(), other.raw_data().begin(), res.begin(), std::multiplies<double>());
-        add_tensor.setdata(res);
-        return add_tensor;
+    // Backward passes of the reductions: given the gradient `grad` of the reduced output, return
+    // the gradient of `self`, broadcast back to its shape. `axes` are those of the forward call,
+    // which may or may not have kept the reduced dimensions.
+    template<typename T>
+    BasicTensor<T> sum_backward(const BasicTensor<T>& grad, const BasicTensor<T>& self, const std::vector<size_t>& axes={}) {
+        return ta_ops::TensorSum<T>(self, axes, false).backward(grad);
+    }
+
+    template<typename T>
+    BasicTensor<T> mean_backward(const BasicTensor<T>& grad, const BasicTensor<T>& self, const std::vector<size_t>& axes={}) {
+        return ta_ops::TensorMean<T>(self, axes, false).backward(grad);
     }
 
-    Tensor sin(const Tensor& tensor) { return tensor.apply_transform([](double x) { return std::sin(x); }); }
-    Tensor cos(const Tensor& tensor) { return tensor.apply_transform([](double x) { return std::cos(x); }); }
-    Tensor tan(const Tensor& tensor) { return tensor.apply_transform([](double x) { return std::tan(x); }); }
-    Tensor log(const Tensor& tensor) { return tensor.apply_transform([](double x) { return std::log(x); }); }
-    Tensor exp(const Tensor& tensor) { return tensor.apply_transform([](double x) { return std::exp(x); }); }
+    // The gradient is split evenly between the elements equal to the maximum
+    template<typename T>
+    BasicTensor<T> max_backward(const BasicTensor<T>& grad, const BasicTensor<T>& self, const std::vector<size_t>& axes={}) {
+        return ta_ops::TensorMax<T>(self, axes, false).backward(grad);
+    }
+
+    template<typename T>
+    BasicTensor<T> logsumexp_backward(const BasicTensor<T>& grad, const BasicTensor<T>& self, const std::vector<size_t>& axes={}) {
+        return ta_ops::TensorLogSumExp<T>(self, axes, false).backward(grad);
+    }
+
+    // d|x|/dx = x / |x|, taken as 0 where the norm is 0
+    template<typename T>
+    BasicTensor<T> norm_backward(const BasicTensor<T>& grad, const BasicTensor<T>& self, const std::vector<size_t>& axes={}) {
+        return ta_ops::TensorNorm<T>(self, axes, false).backward(grad);
+    }
 
 } // namespace nabla
 
@@ -0,0 +1,253 @@
+#include "tensor_kernels.hpp"
+#include "cpu_features.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <thread>
+#include <type_traits>
+
+namespace nabla {
+    namespace kernels {
+        namespace {
+            // Cache blocking: a packed mc x kc block of A (196KB) stays in L2 while it is
+            // multiplied by every micro-panel of the packed kc x nc panel of B (4MB, L3); a kc x nr
+            // micro-panel of B (16-32KB) stays in L1 across the micro-tiles of the A block. The
+            // sizes are multiples of every micro-kernel shape below.
+            constexpr size_t gemm_mc = 96;
+            constexpr size_t gemm_kc = 256;
+            constexpr size_t gemm_nc = 2048;
+
+            // C tile (m x n <= mr x nr, row stride ldc) = (or +=) packed A micro-panel (kc x mr,
+            // column-major) times packed B micro-panel (kc x nr, row-major)
+            using MicroKernelFn = void (*)(size_t kc, const double* a, const double* b, double* c, size_t ldc,
+                                           size_t m, size_t n, bool accumulate);
+
+            struct MicroKernel {
+                size_t mr;
+                size_t nr;
+                MicroKernelFn fn;
+            };
+
+            // Write the mr x nr accumulators in `tile` (row-major) to the m x n corner of C
+            void store_partial_(const double* tile, size_t nr, double* c, size_t ldc, size_t m, size_t n, bool accumulate) {
+                for (size_t i = 0; i < m; ++i)
+                    for (size_t j = 0; j < n; ++j)
+                        c[i * ldc + j] = accumulate ? c[i * ldc + j] + tile[i * nr + j] : tile[i * nr + j];
+            }
+
+            void kernel_4x4_(size_t kc, const double* a, const double* b, double* c, size_t ldc,
+                             size_t m, size_t n, bool accumulate) {
+                double acc[4 * 4] = {};
+                for (size_t p = 0; p < kc; ++p, a += 4, b += 4)
+                    for (size_t i = 0; i < 4; ++i)
+                        for (size_t j = 0; j < 4; ++j) acc[i * 4 + j] += a[i] * b[j];
+                store_partial_(acc, 4, c, ldc, m, n, accumulate);
+            }
+
+#ifdef NABLA_SIMD_DISPATCH
+            // 6 rows of 2 ymm accumulators: 12 of the 16 registers, plus 2 for the B row and one
+            // for the broadcast A element
+            NABLA_TARGET_AVX2 void kernel_6x8_avx2_(size_t kc, const double* a, const double* b, double* c, size_t ldc,
+                                                    size_t m, size_t n, bool accumulate) {
+                constexpr size_t mr = 6, nr = 8;
+                __m256d acc[mr][2];
+#pragma GCC unroll 6
+                for (size_t i = 0; i < mr; ++i) acc[i][0] = acc[i][1] = _mm256_setzero_pd();
+                for (size_t p = 0; p < kc; ++p, a += mr, b += nr) {
+                    __m256d b0 = _mm256_loadu_pd(b), b1 = _mm256_loadu_pd(b + 4);
+#pragma GCC unroll 6
+                    for (size_t i = 0; i < mr; ++i) {
+                        __m256d ai = _mm256_broadcast_sd(a + i);
+                        acc[i][0] = _mm256_fmadd_pd(ai, b0, acc[i][0]);
+                        acc[i][1] = _mm256_fmadd_pd(ai, b1, acc[i][1]);
+                    }
+                }
+
+                if (m == mr && n == nr) {
+#pragma GCC unroll 6
+                    for (size_t i = 0; i < mr; ++i) {
+                        double* row = c + i * ldc;
+                        if (accumulate) {
+                            acc[i][0] = _mm256_add_pd(acc[i][0], _mm256_loadu_pd(row));
+                            acc[i][1] = _mm256_add_pd(acc[i][1], _mm256_loadu_pd(row + 4));
+                        }
+                        _mm256_storeu_pd(row, acc[i][0]);
+                        _mm256_storeu_pd(row + 4, acc[i][1]);
+                    }
+                    return;
+                }
+                double tile[mr * nr];
+                for (size_t i = 0; i < mr; ++i) {
+                    _mm256_storeu_pd(tile + i * nr, acc[i][0]);
+                    _mm256_storeu_pd(tile + i * nr + 4, acc[i][1]);
+                }
+                store_partial_(tile, nr, c, ldc, m, n, accumulate);
+            }
+
+            // 12 rows of 2 zmm accumulators: 24 of the 32 registers
+            NABLA_TARGET_AVX512 void kernel_12x16_avx512_(size_t kc, const double* a, const double* b, double* c,
+                                                          size_t ldc, size_t m, size_t n, bool accumulate) {
+                constexpr size_t mr = 12, nr = 16;
+                __m512d acc[mr][2];
+#pragma GCC unroll 12
+                for (size_t i = 0; i < mr; ++i) acc[i][0] = acc[i][1] = _mm512_setzero_pd();
+                for (size_t p = 0; p < kc; ++p, a += mr, b += nr) {
+                    __m512d b0 = _mm512_loadu_pd(b), b1 = _mm512_loadu_pd(b + 8);
+#pragma GCC unroll 12
+                    for (size_t i = 0; i < mr; ++i) {
+                        __m512d ai = _mm512_set1_pd(a[i]);
+                        acc[i][0] = _mm512_fmadd_pd(ai, b0, acc[i][0]);
+                        acc[i][1] = _mm512_fmadd_pd(ai, b1, acc[i][1]);
+                    }
+                }
+
+                if (m == mr && n == nr) {
+#pragma GCC unroll 12
+                    for (size_t i = 0; i < mr; ++i) {
+                        double* row = c + i * ldc;
+                        if (accumulate) {
+                            acc[i][0] = _mm512_add_pd(acc[i][0], _mm512_loadu_pd(row));
+                            acc[i][1] = _mm512_add_pd(acc[i][1], _mm512_loadu_pd(row + 8));
+                        }
+                        _mm512_storeu_pd(row, acc[i][0]);
+                        _mm512_storeu_pd(row + 8, acc[i][1]);
+                    }
+                    return;
+                }
+                double tile[mr * nr];
+                for (size_t i = 0; i < mr; ++i) {
+                    _mm512_storeu_pd(tile + i * nr, acc[i][0]);
+                    _mm512_storeu_pd(tile + i * nr + 8, acc[i][1]);
+                }
+                store_partial_(tile, nr, c, ldc, m, n, accumulate);
+            }
+#endif
+
+            const MicroKernel& micro_kernel_() {
+                static const MicroKernel kernel = [] {
+#ifdef NABLA_SIMD_DISPATCH
+                    if (cpu::has_avx512()) return MicroKernel{ 12, 16, kernel_12x16_avx512_ };
+                    if (cpu::has_avx2()) return MicroKernel{ 6, 8, kernel_6x8_avx2_ };
+#endif
+                    return MicroKernel{ 4, 4, kernel_4x4_ };
+                }();
+                return kernel;
+            }
+
+            // Pack the mc x kc block of A at `a` as micro-panels of `mr` rows, each stored
+            // column by column (`kc` columns of `mr` elements), the last one zero-padded
+            template<typename T>
+            void pack_a_(size_t mc, size_t kc, const T* a, size_t rs, size_t cs, size_t mr, double* dst) {
+                for (size_t ir = 0; ir < mc; ir += mr) {
+                    size_t rows = std::min(mr, mc - ir);
+                    const T* src = a + ir * rs;
+                    for (size_t p = 0; p < kc; ++p, dst += mr) {
+                        for (size_t i = 0; i < rows; ++i) dst[i] = src[i * rs + p * cs];
+                        for (size_t i = rows; i < mr; ++i) dst[i] = 0.;
+                    }
+                }
+            }
+
+            // Pack the micro-panel of B made of the `cols` (<= nr) columns at `b`, over kc rows, row
+            // by row (`kc` rows of `nr` elements), zero-padded to nr columns
+            template<typename T>
+            void pack_b_(size_t kc, size_t cols, const T* b, size_t rs, size_t cs, size_t nr, double* dst) {
+                for (size_t p = 0; p < kc; ++p, dst += nr) {
+                    const T* src = b + p * rs;
+                    for (size_t j = 0; j < cols; ++j) dst[j] = src[j * cs];
+                    for (size_t j = cols; j < nr; ++j) dst[j] = 0.;
+                }
+            }
+
+            // Packed panels are double whatever `T`: float operands are widened while packed, and
+            // the tiles of a float C are computed in double before being narrowed
+            template<typename T>
+            void gemm_(size_t m, size_t n, size_t k, const T* a, size_t a_rs, size_t a_cs,
+                       const T* b, size_t b_rs, size_t b_cs, T* c, size_t ldc,
+                       bool accumulate, size_t num_threads) {
+                if (m == 0 || n == 0) return;
+                if (k == 0) {
+                    if (!accumulate)
+                        for (size_t i = 0; i < m; ++i) std::fill(c + i * ldc, c + i * ldc + n, T(0));
+                    return;
+                }
+
+                const MicroKernel& kernel = micro_kernel_();
+                const size_t mr = kernel.mr, nr = kernel.nr;
+                if (num_threads == 0)
+                    num_threads = 2. * double(m) * double(n) * double(k) >= parallel_gemm_flops ? parallel::default_num_threads() : 1;
+
+                size_t m_blocks = (m + gemm_mc - 1) / gemm_mc;
+                std::vector<double> b_pack(std::min(k, gemm_kc) * ((std::min(n, gemm_nc) + nr - 1) / nr * nr));
+
+                // Threads are spawned once and share each packed B panel; a barrier separates the
+                // packing of a panel from its use, and its use from the packing of the next one
+                parallel::Barrier barrier(num_threads);
+                auto worker = [&](size_t thread_id) {
+                    std::vector<double> a_pack((std::min(m, gemm_mc) + mr - 1) / mr * mr * std::min(k, gemm_kc));
+                    std::vector<double> tile(std::is_same<T, double>::value ? 0 : mr * nr);
+                    for (size_t jc = 0; jc < n; jc += gemm_nc) {
+                        size_t nc = std::min(gemm_nc, n - jc);
+                        size_t n_panels = (nc + nr - 1) / nr;
+                        // units of work: an mc block of rows times a range of B micro-panels, with
+                        // enough ranges per row block to give every thread a few units
+                        size_t n_parts = std::min(n_panels, std::max<size_t>(1, (4 * num_threads + m_blocks - 1) / m_blocks));
+                        if (num_threads == 1) n_parts = 1;
+                        size_t units = m_blocks * n_parts;
+
+                        for (size_t pc = 0; pc < k; pc += gemm_kc) {
+                            size_t kc = std::min(gemm_kc, k - pc);
+                            bool acc = accumulate || pc > 0;
+
+                            for (size_t jr = n_panels * thread_id / num_threads; jr < n_panels * (thread_id + 1) / num_threads; ++jr)
+                                pack_b_(kc, std::min(nr, nc - jr * nr), b + pc * b_rs + (jc + jr * nr) * b_cs, b_rs, b_cs, nr,
+                                        b_pack.data() + jr * nr * kc);
+                            barrier.wait();
+
+                            for (size_t unit = thread_id; unit < units; unit += num_threads) {
+                                size_t i0 = unit / n_parts * gemm_mc, part = unit % n_parts;
+                                size_t mc = std::min(gemm_mc, m - i0);
+                                pack_a_(mc, kc, a + i0 * a_rs + pc * a_cs, a_rs, a_cs, mr, a_pack.data());
+                                for (size_t jr = n_panels * part / n_parts; jr < n_panels * (part + 1) / n_parts; ++jr) {
+                                    const double* b_panel = b_pack.data() + jr * nr * kc;
+                                    size_t cols = std::min(nr, nc - jr * nr);
+                                    for (size_t ir = 0; ir < mc; ir += mr) {
+                                        T* c_tile = c + (i0 + ir) * ldc + jc + jr * nr;
+                                        size_t rows = std::min(mr, mc - ir);
+                                        if constexpr (std::is_same<T, double>::value) {
+                                            kernel.fn(kc, a_pack.data() + ir * kc, b_panel, c_tile, ldc, rows, cols, acc);
+                                        } else {
+                                            kernel.fn(kc, a_pack.data() + ir * kc, b_panel, tile.data(), nr, mr, nr, false);
+                                            for (size_t i = 0; i < rows; ++i)
+                                                for (size_t j = 0; j < cols; ++j)
+                                                    c_tile[i * ldc + j] = T(acc ? c_tile[i * ldc + j] + tile[i * nr + j] : tile[i * nr + j]);
+                                        }
+                                    }
+                                }
+                            }
+                            barrier.wait();
+                        }
+                    }
+                };
+
+                std::vector<std::thread> workers;
+                workers.reserve(num_threads - 1);
+                for (size_t t = 1; t < num_threads; ++t) workers.emplace_back(worker, t);
+                worker(0);
+                for (auto& w : workers) w.join();
+            }
+        } // namespace
+
+        void gemm(size_t m, size_t n, size_t k, const double* a, size_t a_rs, size_t a_cs,
+                  const double* b, size_t b_rs, size_t b_cs, double* c, size_t ldc,
+                  bool accumulate, size_t num_threads) {
+            gemm_(m, n, k, a, a_rs, a_cs, b, b_rs, b_cs, c, ldc, accumulate, num_threads);
+        }
+
+        void gemm(size_t m, size_t n, size_t k, const float* a, size_t a_rs, size_t a_cs,
+                  const float* b, size_t b_rs, size_t b_cs, float* c, size_t ldc,
+                  bool accumulate, size_t num_threads) {
+            gemm_(m, n, k, a, a_rs, a_cs, b, b_rs, b_cs, c, ldc, accumulate, num_threads);
+        }
+    } // namespace kernels
+} // namespace nabla
@@ -0,0 +1,235 @@
+#ifndef TENSOR_KERNELS_H
+#define TENSOR_KERNELS_H
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include "parallel.hpp"
+
+namespace nabla {
+    // Low-level loops over raw tensor buffers used by the tensor operators. Shapes and strides
+    // are given in elements, as in `Tensor::shape()` and `Tensor::stride()`. Kernels taking an
+    // element type `T` are instantiated for float and double.
+    namespace kernels {
+        // Copy the strided array at `src` with the given shape and strides to the row-major
+        // array `dst`. Adjacent dimensions that are contiguous in `src` are merged first; when
+        // the innermost source stride is not 1 (e.g. a permuted view) the copy runs as a
+        // cache-blocked transpose between the source's unit-stride dimension and the last
+        // dimension, with 4x4 AVX tiles (of doubles) when available. Large copies are split
+        // across threads.
+        template<typename T>
+        void copy_to_contiguous(const T* src, const std::vector<size_t>& shape,
+                                const std::vector<size_t>& stride, T* dst);
+
+        // Shape of the result of an elementwise operation on operands of shapes `a` and `b`,
+        // following NumPy broadcasting: shapes are aligned on their last dimension and each pair
+        // of sizes must be equal or contain a 1. Throws std::invalid_argument otherwise.
+        std::vector<size_t> broadcast_shapes(const std::vector<size_t>& a, const std::vector<size_t>& b);
+
+        // Elements iterated together over K strided operands sharing one shape (a broadcast
+        // operand has stride 0 along its broadcast dimensions). Dimensions of size 1 are dropped
+        // and neighbours that are contiguous for every operand are merged, so that the loop
+        // runs over as few and as long innermost runs as possible.
+        template<size_t K>
+        struct StridedLoop {
+            using Offsets = std::array<size_t, K>;
+
+            StridedLoop(const std::vector<size_t>& shape, const std::array<std::vector<size_t>, K>& strides) {
+                m_size = 1;
+                for (size_t d = 0; d < shape.size(); ++d) {
+                    m_size *= shape[d];
+                    if (shape[d] == 1) continue;
+                    bool merge = !m_shape.empty();
+                    for (size_t k = 0; k < K && merge; ++k)
+                        merge = m_strides[k].back() == strides[k][d] * shape[d];
+                    if (merge) {
+                        m_shape.back() *= shape[d];
+                        for (size_t k = 0; k < K; ++k) m_strides[k].back() = strides[k][d];
+                    } else {
+                        m_shape.push_back(shape[d]);
+                        for (size_t k = 0; k < K; ++k) m_strides[k].push_back(strides[k][d]);
+                    }
+                }
+            }
+
+            size_t size() const { return m_size; }
+            size_t inner_size() const { return m_shape.empty() ? 1 : m_shape.back(); }
+            // Strides of the operands along the innermost run
+            Offsets inner_strides() const {
+                Offsets s{};
+                if (!m_shape.empty()) for (size_t k = 0; k < K; ++k) s[k] = m_strides[k].back();
+                return s;
+            }
+
+            // Call `inner(offsets, n, strides)` for every innermost run of `n` elements, where
+            // `offsets` are the operand offsets of its first element and `strides` the operand
+            // strides along the run. With `num_threads` != 1 the runs are split across threads;
+            // only do this when no two runs write the same elements.
+            template<typename F>
+            void run(F inner, size_t num_threads = 1) const {
+                if (m_size == 0) return;
+                size_t n = inner_size();
+                Offsets strides = inner_strides();
+                size_t runs = m_size / n;
+                size_t chunk = std::max<size_t>(1, (size_t(1) << 14) / n);
+                parallel::for_chunks(runs, num_threads, chunk, [&](size_t, size_t begin, size_t end) {
+                    for (size_t r = begin; r < end; ++r) inner(this->offsets_(r), n, strides);
+                });
+            }
+
+        private:
+            // Offsets of the first element of the `run`-th innermost run
+            Offsets offsets_(size_t run) const {
+                Offsets offsets{};
+                if (m_shape.empty()) return offsets;
+                for (size_t d = m_shape.size() - 1; d-- > 0;) {
+                    size_t i = run % m_shape[d];
+                    run /= m_shape[d];
+                    for (size_t k = 0; k < K; ++k) offsets[k] += i * m_strides[k][d];
+                }
+                return offsets;
+            }
+
+            size_t m_size;
+            std::vector<size_t> m_shape;
+            std::array<std::vector<size_t>, K> m_strides;
+        };
+
+        // Elements per thread below which elementwise loops stay single-threaded
+        constexpr size_t parallel_elementwise_elements = 1 << 18;
+
+        // Elementwise functions with dedicated vectorized kernels. On x86-64 CPUs supporting AVX2
+        // and FMA (detected at run time, the library itself is built for the baseline ISA) they
+        // process 4 doubles per instruction; elsewhere they fall back to scalar loops. Float
+        // arrays run on the same unary kernels, widened to double on load and narrowed on store.
+        enum class UnaryFn { exp, log, sin, cos, tanh };
+        enum class BinaryFn { add, sub, mul, div };
+
+        // y[i] = fn(x[i]) for i in [0, n) over contiguous arrays; `y` may equal `x`. The vector
+        // kernels use polynomial approximations; their maximum error against the exact result,
+        // measured on 4M random arguments per range, is
+        //   exp   1 ulp     for x in [-708, 709]
+        //   log   2 ulp     for normal positive x
+        //   sin   2.5 ulp   for |x| <= 1e5 (1.5 ulp for |x| <= 4)
+        //   cos   2.5 ulp   for |x| <= 1e5 (1.5 ulp for |x| <= 4)
+        //   tanh  3 ulp     for any non-NaN x
+        // Blocks holding an argument outside these ranges (including infinities, NaN, zero and
+        // subnormals for log) are evaluated with the <cmath> functions instead, so special values
+        // behave as in the standard library. Large arrays are split across threads.
+        void unary_map(UnaryFn fn, const double* x, double* y, size_t n);
+        void unary_map(UnaryFn fn, const float* x, float* y, size_t n);
+
+        // o[i] = fn(x[i * x_stride], y[i * y_stride]) for i in [0, n), where each stride is 0 (a
+        // broadcast scalar) or 1. Results are exactly those of the scalar operators: unlike the
+        // unary kernels, float arrays are not widened but run 8 floats per instruction.
+        void binary_run(BinaryFn fn, const double* x, size_t x_stride, const double* y, size_t y_stride,
+                        double* o, size_t n);
+        void binary_run(BinaryFn fn, const float* x, size_t x_stride, const float* y, size_t y_stride,
+                        float* o, size_t n);
+
+        namespace detail {
+            // The vectorized `BinaryFn` matching an operator type passed to `binary_map()`, if any
+            template<typename Op> struct VectorizedOp : std::false_type {};
+            template<> struct VectorizedOp<std::plus<double>> : std::true_type { static constexpr BinaryFn fn = BinaryFn::add; };
+            template<> struct VectorizedOp<std::minus<double>> : std::true_type { static constexpr BinaryFn fn = BinaryFn::sub; };
+            template<> struct VectorizedOp<std::multiplies<double>> : std::true_type { static constexpr BinaryFn fn = BinaryFn::mul; };
+            template<> struct VectorizedOp<std::divides<double>> : std::true_type { static constexpr BinaryFn fn = BinaryFn::div; };
+            template<> struct VectorizedOp<std::plus<float>> : std::true_type { static constexpr BinaryFn fn = BinaryFn::add; };
+            template<> struct VectorizedOp<std::minus<float>> : std::true_type { static constexpr BinaryFn fn = BinaryFn::sub; };
+            template<> struct VectorizedOp<std::multiplies<float>> : std::true_type { static constexpr BinaryFn fn = BinaryFn::mul; };
+            template<> struct VectorizedOp<std::divides<float>> : std::true_type { static constexpr BinaryFn fn = BinaryFn::div; };
+        } // namespace detail
+
+        // out = op(a, b) elementwise over `shape`; the operands are given with their strides over
+        // `shape` (0 along broadcast dimensions), `out` is row-major. On doubles and floats the
+        // std::plus, std::minus, std::multiplies and std::divides operators run on the vectorized
+        // `binary_run()` kernel; other loops are left to the compiler's vectorizer.
+        template<typename T, typename Op>
+        void binary_map(const std::vector<size_t>& shape, const T* a, const std::vector<size_t>& a_stride,
+                        const T* b, const std::vector<size_t>& b_stride, T* out, Op op) {
+            std::vector<size_t> out_stride(shape.size());
+            size_t current = 1;
+            for (size_t d = shape.size(); d-- > 0;) {
+                out_stride[d] = current;
+                current *= shape[d];
+            }
+
+            StridedLoop<3> loop(shape, { out_stride, a_stride, b_stride });
+            size_t num_threads = loop.size() >= parallel_elementwise_elements ? 0 : 1;
+            loop.run([&](const std::array<size_t, 3>& offsets, size_t n, const std::array<size_t, 3>& strides) {
+                T* o = out + offsets[0];
+                const T* x = a + offsets[1];
+                const T* y = b + offsets[2];
+                if constexpr (detail::VectorizedOp<Op>::value) {
+                    if (strides[1] <= 1 && strides[2] <= 1) {
+                        binary_run(detail::VectorizedOp<Op>::fn, x, strides[1], y, strides[2], o, n);
+                        return;
+                    }
+                }
+                // specialized runs: both operands contiguous, or one of them broadcast (scalar)
+                if (strides[1] == 1 && strides[2] == 1) {
+                    for (size_t i = 0; i < n; ++i) o[i] = op(x[i], y[i]);
+                } else if (strides[1] == 1 && strides[2] == 0) {
+                    const T y0 = *y;
+                    for (size_t i = 0; i < n; ++i) o[i] = op(x[i], y0);
+                } else if (strides[1] == 0 && strides[2] == 1) {
+                    const T x0 = *x;
+                    for (size_t i = 0; i < n; ++i) o[i] = op(x0, y[i]);
+                } else {
+                    for (size_t i = 0; i < n; ++i) o[i] = op(x[i * strides[1]], y[i * strides[2]]);
+                }
+            }, num_threads);
+        }
+
+        // General matrix product: C = A B, or C += A B when `accumulate`, where A is m x k with
+        // element (i, p) at `a[i * a_rs + p * a_cs]`, B is k x n with element (p, j) at
+        // `b[p * b_rs + j * b_cs]`, and C is m x n with element (i, j) at `c[i * ldc + j]`.
+        // Any strides are accepted: operands are packed into contiguous panels anyway, so
+        // transposed views cost nothing extra. Follows the BLIS design: the k dimension is cut
+        // into panels fitting L2 (A blocks) and L3 (B panels), and a register-blocked micro-kernel
+        // (12x16 with AVX-512, 6x8 with AVX2 and FMA, 4x4 portable C++) computes each tile.
+        // Float operands are widened to double while packed and run on the same micro-kernels,
+        // so float products accumulate each k panel in double and cost as much compute as
+        // double ones, with half the memory traffic.
+        // With `num_threads` != 1 the tiles of C are split across threads; 0 picks all hardware
+        // threads for products large enough to benefit.
+        // Products of fewer flops stay single-threaded
+        constexpr double parallel_gemm_flops = double(1 << 23);
+
+        void gemm(size_t m, size_t n, size_t k, const double* a, size_t a_rs, size_t a_cs,
+                  const double* b, size_t b_rs, size_t b_cs, double* c, size_t ldc,
+                  bool accumulate = false, size_t num_threads = 0);
+        void gemm(size_t m, size_t n, size_t k, const float* a, size_t a_rs, size_t a_cs,
+                  const float* b, size_t b_rs, size_t b_cs, float* c, size_t ldc,
+                  bool accumulate = false, size_t num_threads = 0);
+
+        enum class ReduceOp { sum, sum_squares, max, argmax };
+
+        // Reduce the strided array `src` of the given shape and strides over its last
+        // `shape.size() - kept` dimensions into the row-major array `dst` over its first `kept`
+        // dimensions. `argmax` writes the row-major index, over the reduced dimensions, of the
+        // first maximum; `max` and `argmax` propagate NaN (the first NaN is the maximum).
+        // Sums are pairwise over blocks accumulated in SIMD lanes when the reduced elements are
+        // contiguous, and Kahan-compensated when they are reduced across rows (e.g. over the first
+        // dimension of a row-major matrix); other layouts are first copied with
+        // `copy_to_contiguous()`. Large reductions are split across threads, over outputs or,
+        // when there are few, over the reduced elements with the partial results combined. Float
+        // elements are accumulated in double. `dst` holds elements of type `T`, or doubles (float
+        // sources only), which represent every index exactly where float stops at 2^24.
+        template<typename T, typename D>
+        void reduce(ReduceOp op, const T* src, const std::vector<size_t>& shape,
+                    const std::vector<size_t>& stride, size_t kept, D* dst);
+
+        // Sum the row-major array `src` of shape `shape` into `dst`, given with its strides over
+        // `shape` (0 along the dimensions being summed over). `dst` must be zeroed beforehand.
+        // Instantiated for (T, A) = (double, double), (float, float) and (float, double).
+        template<typename T, typename A>
+        void sum_broadcast(const std::vector<size_t>& shape, const T* src, A* dst,
+                           const std::vector<size_t>& dst_stride);
+    } // namespace kernels
+} // namespace nabla
+
+#endif
@@ -0,0 +1,332 @@
+#include "tensor_lazy.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace nabla {
+    namespace lazy {
+        namespace detail {
+            struct Node {
+                enum class Kind { leaf, constant, unary, binary };
+
+                Kind kind;
+                std::vector<size_t> shape;
+                Tensor tensor;     // leaf
+                double value = 0.; // constant
+                kernels::UnaryFn unary_fn = kernels::UnaryFn::exp;
+                kernels::BinaryFn binary_fn = kernels::BinaryFn::add;
+                std::shared_ptr<const Node> a, b;
+            };
+
+            Expr unary(kernels::UnaryFn fn, const Expr& a) {
+                auto node = std::make_shared<Node>();
+                node->kind = Node::Kind::unary;
+                node->shape = a.node_->shape;
+                node->unary_fn = fn;
+                node->a = a.node_;
+                return Expr(std::move(node));
+            }
+
+            Expr binary(kernels::BinaryFn fn, const Expr& a, const Expr& b) {
+                auto node = std::make_shared<Node>();
+                node->kind = Node::Kind::binary;
+                node->shape = kernels::broadcast_shapes(a.node_->shape, b.node_->shape);
+                node->binary_fn = fn;
+                node->a = a.node_;
+                node->b = b.node_;
+                return Expr(std::move(node));
+            }
+        } // namespace detail
+
+        namespace {
+            using detail::Node;
+
+            // The expression DAG flattened in topological order (operands first, the root last),
+            // each node becoming a slot holding its values on the current block
+            struct Program {
+                explicit Program(const Node* root) : shape{root->shape} {
+                    size = 1;
+                    for (size_t s : shape) size *= s;
+                    add_(root);
+                }
+
+                size_t slot_of(const Node* node) const {
+                    auto it = index.find(node);
+                    return it == index.end() ? size_t(-1) : it->second;
+                }
+
+                std::vector<size_t> shape;
+                size_t size;
+                std::vector<const Node*> nodes;
+                std::vector<size_t> a, b; // operand slots
+                std::vector<Tensor> views; // leaves broadcast to `shape`
+                std::unordered_map<const Node*, size_t> index;
+
+            private:
+                size_t add_(const Node* node) {
+                    auto it = index.find(node);
+                    if (it != index.end()) return it->second;
+                    size_t sa = node->a ? add_(node->a.get()) : 0;
+                    size_t sb = node->b ? add_(node->b.get()) : 0;
+                    size_t slot = nodes.size();
+                    nodes.push_back(node);
+                    a.push_back(sa);
+                    b.push_back(sb);
+                    views.push_back(node->kind == Node::Kind::leaf ? node->tensor.broadcast_to(shape) : Tensor());
+                    index.emplace(node, slot);
+                    return slot;
+                }
+            };
+
+            // Values of one slot on the current block: `ptr[i * stride]`, with a stride of 0 for
+            // constants and expressions of constants
+            struct Block {
+                const double* ptr;
+                size_t stride;
+            };
+
+            // dst[i] = element `begin + i` (row-major) of the strided `view`, i in [0, n)
+            void gather_(const Tensor& view, size_t begin, size_t n, double* dst) {
+                const std::vector<size_t>& shape = view.shape();
+                const std::vector<size_t>& stride = view.stride();
+                std::vector<size_t> index(shape.size());
+                size_t offset = 0;
+                for (size_t d = shape.size(), rest = begin; d-- > 0;) {
+                    index[d] = rest % shape[d];
+                    rest /= shape[d];
+                    offset += index[d] * stride[d];
+                }
+                const double* src = view.data();
+                for (size_t i = 0; i < n; ++i) {
+                    dst[i] = src[offset];
+                    for (size_t d = shape.size(); d-- > 0;) {
+                        offset += stride[d];
+                        if (++index[d] < shape[d]) break;
+                        offset -= stride[d] * shape[d];
+                        index[d] = 0;
+                    }
+                }
+            }
+
+            bool all_zero_(const std::vector<size_t>& stride) {
+                return std::all_of(stride.begin(), stride.end(), [](size_t s) { return s == 0; });
+            }
+
+            // Compute the values of every slot on the block [begin, begin + n). `scratch` holds
+            // `block_size` elements per slot; the root is written to `out` when given.
+            void forward_block_(const Program& program, size_t begin, size_t n, double* scratch,
+                                std::vector<Block>& values, double* out = nullptr) {
+                size_t root = program.nodes.size() - 1;
+                for (size_t slot = 0; slot < program.nodes.size(); ++slot) {
+                    const Node* node = program.nodes[slot];
+                    double* dst = (out && slot == root) ? out : scratch + slot * block_size;
+                    switch (node->kind) {
+                        case Node::Kind::constant:
+                            values[slot] = { &node->value, 0 };
+                            break;
+                        case Node::Kind::leaf: {
+                            const Tensor& view = program.views[slot];
+                            if (view.is_contiguous()) {
+                                values[slot] = { view.data() + begin, 1 };
+                            } else if (all_zero_(view.stride())) {
+                                values[slot] = { view.data(), 0 };
+                            } else {
+                                gather_(view, begin, n, dst);
+                                values[slot] = { dst, 1 };
+                            }
+                            break;
+                        }
+                        case Node::Kind::unary: {
+                            Block x = values[program.a[slot]];
+                            kernels::unary_map(node->unary_fn, x.ptr, dst, x.stride ? n : 1);
+                            values[slot] = { dst, x.stride };
+                            break;
+                        }
+                        case Node::Kind::binary: {
+                            Block x = values[program.a[slot]], y = values[program.b[slot]];
+                            size_t stride = (x.stride || y.stride) ? 1 : 0;
+                            kernels::binary_run(node->binary_fn, x.ptr, x.stride, y.ptr, y.stride, dst, stride ? n : 1);
+                            values[slot] = { dst, stride };
+                            break;
+                        }
+                    }
+                }
+
+                if (out && (values[root].ptr != out || values[root].stride == 0)) {
+                    // the root is a leaf or an expression of constants
+                    Block r = values[root];
+                    for (size_t i = 0; i < n; ++i) out[i] = r.ptr[i * r.stride];
+                }
+            }
+
+            // Per-thread buffers of a pass over the blocks
+            struct Workspace {
+                std::vector<double> scratch;
+                std::vector<Block> values;
+            };
+
+            // Run `fn(begin, n, workspace)` for every block of the output of `program`, in
+            // parallel for large outputs, with `scratch_blocks` blocks of scratch space per thread
+            template<typename F>
+            void for_blocks_(const Program& program, size_t scratch_blocks, F fn) {
+                size_t size = program.size;
+                size_t blocks = (size + block_size - 1) / block_size;
+                size_t num_threads = size >= kernels::parallel_elementwise_elements ? parallel::default_num_threads() : 1;
+                std::vector<Workspace> workspaces(num_threads);
+                parallel::for_chunks(blocks, num_threads, 0, [&](size_t thread, size_t first, size_t last) {
+                    Workspace& workspace = workspaces[thread];
+                    if (workspace.scratch.empty()) {
+                        workspace.scratch.resize(scratch_blocks * block_size);
+                        workspace.values.resize(program.nodes.size());
+                    }
+                    for (size_t block = first; block < last; ++block) {
+                        size_t begin = block * block_size;
+                        fn(begin, std::min(block_size, size - begin), workspace);
+                    }
+                });
+            }
+        } // namespace
+
+        Expr::Expr(const Tensor& tensor) {
+            auto node = std::make_shared<Node>();
+            node->kind = Node::Kind::leaf;
+            node->shape = tensor.shape();
+            node->tensor = tensor;
+            node_ = std::move(node);
+        }
+
+        Expr::Expr(double value) {
+            auto node = std::make_shared<Node>();
+            node->kind = Node::Kind::constant;
+            node->value = value;
+            node_ = std::move(node);
+        }
+
+        const std::vector<size_t>& Expr::shape() const { return node_->shape; }
+
+        Tensor Expr::eval() const {
+            Program program(node_.get());
+            bool requires_grad = std::any_of(program.nodes.begin(), program.nodes.end(), [](const Node* node) {
+                return node->kind == Node::Kind::leaf && node->tensor.requires_grad();
+            });
+            Tensor out(program.shape, requires_grad);
+            double* dst = out.data();
+
+            for_blocks_(program, program.nodes.size(), [&](size_t begin, size_t n, Workspace& workspace) {
+                forward_block_(program, begin, n, workspace.scratch.data(), workspace.values, dst + begin);
+            });
+            return out;
+        }
+
+        std::vector<Tensor> Expr::backward(const Tensor& grad, const std::vector<Expr>& wrt) const {
+            Program program(node_.get());
+            size_t slots = program.nodes.size();
+            Tensor upstream = grad.broadcast_to(program.shape);
+
+            // slots whose adjoint is needed: the requested leaves and the nodes depending on them
+            std::vector<bool> needed(slots, false);
+            std::vector<size_t> wrt_slots(wrt.size());
+            for (size_t i = 0; i < wrt.size(); ++i) {
+                wrt_slots[i] = program.slot_of(wrt[i].node_.get());
+                if (wrt_slots[i] != size_t(-1)) needed[wrt_slots[i]] = true;
+            }
+            for (size_t slot = 0; slot < slots; ++slot) {
+                const Node* node = program.nodes[slot];
+                if (node->kind == Node::Kind::unary) needed[slot] = needed[slot] || needed[program.a[slot]];
+                if (node->kind == Node::Kind::binary)
+                    needed[slot] = needed[slot] || needed[program.a[slot]] || needed[program.b[slot]];
+            }
+
+            // Gradients over the broadcast shape, reduced to the shapes of the leaves at the end
+            std::unordered_map<size_t, Tensor> full;
+            for (size_t slot : wrt_slots)
+                if (slot != size_t(-1) && !full.count(slot)) full.emplace(slot, Tensor(program.shape));
+
+            // scratch: the values, then the adjoints, of every slot, and one temporary block
+            for_blocks_(program, 2 * slots + 1, [&](size_t begin, size_t n, Workspace& workspace) {
+                double* scratch = workspace.scratch.data();
+                const std::vector<Block>& values = workspace.values;
+                forward_block_(program, begin, n, scratch, workspace.values);
+
+                double* adjoints = scratch + slots * block_size;
+                double* tmp = adjoints + slots * block_size;
+                std::fill(adjoints, adjoints + slots * block_size, 0.);
+                double* root = adjoints + (slots - 1) * block_size;
+                if (upstream.is_contiguous()) std::copy(upstream.data() + begin, upstream.data() + begin + n, root);
+                else gather_(upstream, begin, n, root);
+
+                for (size_t slot = slots; slot-- > 0;) {
+                    const Node* node = program.nodes[slot];
+                    if (!needed[slot] || node->kind == Node::Kind::leaf || node->kind == Node::Kind::constant) continue;
+                    const double* g = adjoints + slot * block_size;
+                    size_t sa = program.a[slot], sb = program.b[slot];
+                    double* ga = adjoints + sa * block_size;
+                    double* gb = adjoints + sb * block_size;
+                    Block x = values[sa], y = values[sb], v = values[slot];
+
+                    if (node->kind == Node::Kind::binary) {
+                        bool da = needed[sa], db = needed[sb];
+                        switch (node->binary_fn) {
+                            case kernels::BinaryFn::add:
+                                if (da) for (size_t i = 0; i < n; ++i) ga[i] += g[i];
+                                if (db) for (size_t i = 0; i < n; ++i) gb[i] += g[i];
+                                break;
+                            case kernels::BinaryFn::sub:
+                                if (da) for (size_t i = 0; i < n; ++i) ga[i] += g[i];
+                                if (db) for (size_t i = 0; i < n; ++i) gb[i] -= g[i];
+                                break;
+                            case kernels::BinaryFn::mul:
+                                if (da) for (size_t i = 0; i < n; ++i) ga[i] += g[i] * y.ptr[i * y.stride];
+                                if (db) for (size_t i = 0; i < n; ++i) gb[i] += g[i] * x.ptr[i * x.stride];
+                                break;
+                            case kernels::BinaryFn::div:
+                                if (da) for (size_t i = 0; i < n; ++i) ga[i] += g[i] / y.ptr[i * y.stride];
+                                if (db) for (size_t i = 0; i < n; ++i) gb[i] -= g[i] * v.ptr[i * v.stride] / y.ptr[i * y.stride];
+                                break;
+                        }
+                        continue;
+                    }
+
+                    if (!needed[sa]) continue;
+                    switch (node->unary_fn) {
+                        case kernels::UnaryFn::exp:
+                            for (size_t i = 0; i < n; ++i) ga[i] += g[i] * v.ptr[i * v.stride];
+                            break;
+                        case kernels::UnaryFn::log:
+                            for (size_t i = 0; i < n; ++i) ga[i] += g[i] / x.ptr[i * x.stride];
+                            break;
+                        case kernels::UnaryFn::sin:
+                            kernels::unary_map(kernels::UnaryFn::cos, x.ptr, tmp, x.stride ? n : 1);
+                            for (size_t i = 0; i < n; ++i) ga[i] += g[i] * tmp[i * x.stride];
+                            break;
+                        case kernels::UnaryFn::cos:
+                            kernels::unary_map(kernels::UnaryFn::sin, x.ptr, tmp, x.stride ? n : 1);
+                            for (size_t i = 0; i < n; ++i) ga[i] -= g[i] * tmp[i * x.stride];
+                            break;
+                        case kernels::UnaryFn::tanh:
+                            for (size_t i = 0; i < n; ++i) {
+                                double t = v.ptr[i * v.stride];
+                                ga[i] += g[i] * (1. - t * t);
+                            }
+                            break;
+                    }
+                }
+
+                for (auto& [slot, tensor] : full) {
+                    const double* g = adjoints + slot * block_size;
+                    std::copy(g, g + n, tensor.data() + begin);
+                }
+            });
+
+            std::vector<Tensor> gradients;
+            gradients.reserve(wrt.size());
+            for (size_t i = 0; i < wrt.size(); ++i) {
+                const std::vector<size_t>& shape = wrt[i].shape();
+                if (wrt_slots[i] == size_t(-1)) gradients.push_back(Tensor::zeros(shape));
+                else gradients.push_back(sum_to_shape(full.at(wrt_slots[i]), shape));
+            }
+            return gradients;
+        }
+    } // namespace lazy
+} // namespace nabla
@@ -0,0 +1,90 @@
+#ifndef TENSOR_LAZY_H
+#define TENSOR_LAZY_H
+
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "tensor.hpp"
+#include "tensor_kernels.hpp"
+
+namespace nabla {
+    // Lazily evaluated elementwise tensor expressions. Unlike the operators of `tensor_aops.hpp`,
+    // operators on `nabla::lazy::Expr` do not compute anything: they build a small expression
+    // DAG over their operands, which is evaluated in a single fused pass when the result is read
+    // (`eval()` or conversion to a `Tensor`). The pass walks the output in blocks of
+    // `block_size` elements and computes every node of the DAG on the current block with the
+    // vectorized kernels of `tensor_kernels.hpp`, so intermediate results never leave the cache:
+    // an expression such as `exp(sin(x)) * y + z` reads each operand and writes the result once
+    // and allocates no temporary tensor. Operands broadcast as with the eager operators.
+    //
+    //     nabla::lazy::Expr x = tx, y = ty, z = tz;
+    //     nabla::lazy::Expr f = exp(sin(x)) * y + z;
+    //     nabla::Tensor out = f;                                     // fused forward
+    //     std::vector<nabla::Tensor> g = f.backward(upstream, { x, y }); // fused backward
+    namespace lazy {
+        // Elements of the output processed together; each node of the expression needs one block
+        // of scratch space, so typical expressions keep their working set in L1
+        constexpr size_t block_size = 256;
+
+        class Expr;
+
+        namespace detail {
+            struct Node;
+            Expr unary(kernels::UnaryFn fn, const Expr& a);
+            Expr binary(kernels::BinaryFn fn, const Expr& a, const Expr& b);
+        } // namespace detail
+
+        class Expr {
+        public:
+            // Leaf reading the elements of `tensor`, whose storage is shared (no copy)
+            Expr(const Tensor& tensor);
+            // Expressions are evaluated on blocks of doubles: other element types are rejected at
+            // compile time rather than silently converted
+            template<typename T>
+            Expr(const BasicTensor<T>&) : Expr(0.) {
+                static_assert(std::is_same<T, double>::value,
+                              "nabla::lazy::Expr only supports float64 tensors (nabla::Tensor); convert a FloatTensor "
+                              "with to<double>() or use the eager operators of tensor_aops.hpp");
+            }
+            // Constant, broadcast to the shape of the other operand
+            Expr(double value);
+
+            // Shape of the result (the broadcast shape of the leaves)
+            const std::vector<size_t>& shape() const;
+
+            // Evaluate the expression in one fused pass
+            Tensor eval() const;
+            operator Tensor() const { return eval(); }
+
+            // Gradients of `sum(grad * expr)` with respect to each leaf of `wrt`, reduced to the
+            // shape of the leaf, computed in one fused forward and reverse pass over the blocks.
+            // `grad` must broadcast to `shape()`. Leaves are identified by the `Expr` object they
+            // were created as (copies included), not by tensor: pass the same `Expr` used in the
+            // expression. Leaves absent from the expression get a zero gradient.
+            std::vector<Tensor> backward(const Tensor& grad, const std::vector<Expr>& wrt) const;
+
+            friend Expr detail::unary(kernels::UnaryFn fn, const Expr& a);
+            friend Expr detail::binary(kernels::BinaryFn fn, const Expr& a, const Expr& b);
+
+        private:
+            explicit Expr(std::shared_ptr<const detail::Node> node) : node_{std::move(node)} {}
+
+            std::shared_ptr<const detail::Node> node_;
+        };
+
+        inline Expr operator+(const Expr& a, const Expr& b) { return detail::binary(kernels::BinaryFn::add, a, b); }
+        inline Expr operator-(const Expr& a, const Expr& b) { return detail::binary(kernels::BinaryFn::sub, a, b); }
+        inline Expr operator*(const Expr& a, const Expr& b) { return detail::binary(kernels::BinaryFn::mul, a, b); }
+        inline Expr operator/(const Expr& a, const Expr& b) { return detail::binary(kernels::BinaryFn::div, a, b); }
+        inline Expr operator-(const Expr& a) { return detail::binary(kernels::BinaryFn::mul, Expr(-1.), a); }
+
+        inline Expr exp(const Expr& a) { return detail::unary(kernels::UnaryFn::exp, a); }
+        inline Expr log(const Expr& a) { return detail::unary(kernels::UnaryFn::log, a); }
+        inline Expr sin(const Expr& a) { return detail::unary(kernels::UnaryFn::sin, a); }
+        inline Expr cos(const Expr& a) { return detail::unary(kernels::UnaryFn::cos, a); }
+        inline Expr tanh(const Expr& a) { return detail::unary(kernels::UnaryFn::tanh, a); }
+    } // namespace lazy
+} // namespace nabla
+
+#endif // TENSOR_LAZY_H
@@ -1,130 +1,223 @@
 #include "tensor_ops.hpp"
 #include "gradient_tape.hpp"
+#include "taped_function.hpp"
+#include "profiler.hpp"
 
 #include <cmath>
 
 namespace nabla {
-    Tensor AddBackward(const Tensor& ltensor, const Tensor& rtensor) {
+    Var AddBackward(const Var& ltensor, const Var& rtensor) {
         double primal = ltensor.m_primal + rtensor.m_primal;
-        Tensor add_tensor{primal, false};
+        Var add_tensor{primal, false};
 
         node_index_t tensor_index = GradientTape::instance().push_node(
-            "add_backward_" + std::to_string(ComputationNode::node_id_generator++),
+            OpKind::add,
             { 1.0, 1.0 }, { ltensor.node_gradtape_index, rtensor.node_gradtape_index });
 
         add_tensor.node_gradtape_index = tensor_index;
-        std::cout << "Added tensor " << add_tensor << " to computation graph" << std::endl;
         return add_tensor;
     }
 
-    Tensor SubBackward(const Tensor& ltensor, const Tensor& rtensor) {
+    Var SubBackward(const Var& ltensor, const Var& rtensor) {
         double primal = ltensor.m_primal - rtensor.m_primal;
-        Tensor sub_tensor{primal, false};
+        Var sub_tensor{primal, false};
 
         node_index_t tensor_index = GradientTape::instance().push_node(
-            "sub_backward_" + std::to_string(ComputationNode::node_id_generator++),
+            OpKind::sub,
             { 1.0, -1.0 }, { ltensor.node_gradtape_index, rtensor.node_gradtape_index });
 
         sub_tensor.node_gradtape_index = tensor_index;
-        std::cout << "Added tensor " << sub_tensor << " to computation graph" << std::endl;
         return sub_tensor;
     }
 
-    Tensor MultBackward(const Tensor& ltensor, const Tensor& rtensor) {
-        double primal = ltensor.get_primal() * rtensor.get_primal();
-        Tensor mult_tensor{primal, false};
+    Var MultBackward(const Var& ltensor, const Var& rtensor) {
+        double primal = ltensor.m_primal * rtensor.m_primal;
+        Var mult_tensor{primal, false};
 
         node_index_t tensor_index = GradientTape::instance().push_node(
-            "mult_backward_" + std::to_string(ComputationNode::node_id_generator++),
+            OpKind::mul,
             { rtensor.m_primal, ltensor.m_primal },
             { ltensor.node_gradtape_index, rtensor.node_gradtape_index });
 
         mult_tensor.node_gradtape_index = tensor_index;
-        std::cout << "Added mult_tensor " << mult_tensor << " to computation graph" << std::endl;
         return mult_tensor;
     }
 
-    Tensor DivBackward(const Tensor& ltensor, const Tensor& rtensor) {
+    Var DivBackward(const Var& ltensor, const Var& rtensor) {
         double primal = ltensor.m_primal / rtensor.m_primal;
-        Tensor div_tensor{primal, false};
+        Var div_tensor{primal, false};
 
         div_tensor.node_gradtape_index = GradientTape::instance().push_node(
-            "div_backward_" + std::to_string(ComputationNode::node_id_generator++),
-            { rtensor.m_primal, ltensor.m_primal },
+            OpKind::div,
+            { 1 / rtensor.m_primal, -primal / rtensor.m_primal },
             { ltensor.node_gradtape_index, rtensor.node_gradtape_index });
 
-        std::cout << "Added tensor " << div_tensor << " to computation graph" << std::endl;
         return div_tensor;
     }
 
-    Tensor ExpBackward(const Tensor& tensor) {
+    Var ExpBackward(const Var& tensor) {
         double primal = ::exp(tensor.m_primal);
-        Tensor exp_tensor{primal, false};
+        Var exp_tensor{primal, false};
 
         node_index_t tensor_index = GradientTape::instance().push_node(
-            "exp_backward_" + std::to_string(ComputationNode::node_id_generator++),
+            OpKind::exp,
             primal, tensor.node_gradtape_index);
 
         exp_tensor.node_gradtape_index = tensor_index;
-        std::cout << "Added tensor " << exp_tensor << " to computation graph" << std::endl;
         return exp_tensor;
     }
 
-    Tensor LogBackward(const Tensor& tensor) {
+    Var LogBackward(const Var& tensor) {
         double primal = ::log(tensor.m_primal);
-        Tensor log_tensor{primal, false};
+        Var log_tensor{primal, false};
 
         node_index_t tensor_index = GradientTape::instance().push_node(
-            "log_backward_" + std::to_string(ComputationNode::node_id_generator++),
+            OpKind::log,
             1 / tensor.m_primal, tensor.node_gradtape_index);
 
         log_tensor.node_gradtape_index = tensor_index;
-        std::cout << "Added log_tensor " << log_tensor << " to computation graph" << std::endl;
         return log_tensor;
     }
 
-    Tensor PowerBackward(const Tensor& tensor, unsigned int power) {
+    Var PowerBackward(const Var& tensor, double power) {
         double primal = ::pow(tensor.m_primal, power);
-        Tensor power_tensor{primal, false};
+        Var power_tensor{primal, false};
 
         node_index_t tensor_index = GradientTape::instance().push_node(
-            "power_backward_" + std::to_string(ComputationNode::node_id_generator++),
+            OpKind::power,
             power * ::pow(tensor.m_primal, power - 1),
             tensor.node_gradtape_index);
 
         power_tensor.node_gradtape_index = tensor_index;
-        std::cout << "Added tensor " << power_tensor << " to computation graph" << std::endl;
         return power_tensor;
     }
 
-    Tensor SinBackward(const Tensor& tensor) {
+    Var SinBackward(const Var& tensor) {
         double primal = ::sin(tensor.m_primal);
-        Tensor sin_tensor{primal, false};
+        Var sin_tensor{primal, false};
 
         sin_tensor.node_gradtape_index = GradientTape::instance().push_node(
-            "sin_backward_" + std::to_string(ComputationNode::node_id_generator++),
+            OpKind::sin,
             ::cos(tensor.m_primal), tensor.node_gradtape_index);
 
-        std::cout << "Added sin_tensor " << sin_tensor << " to computation graph" << std::endl;
         return sin_tensor;
     }
 
-    Tensor CosBackward(const Tensor& tensor) {
+    Var CosBackward(const Var& tensor) {
         double primal = ::cos(tensor.m_primal);
-        Tensor cos_tensor{primal, false};
+        Var cos_tensor{primal, false};
 
         cos_tensor.node_gradtape_index = GradientTape::instance().push_node(
-            "cos_backward_" + std::to_string(ComputationNode::node_id_generator++),
+            OpKind::cos,
             -::sin(tensor.m_primal), tensor.node_gradtape_index);
 
-        std::cout << "Added tensor " << cos_tensor << " to computation graph" << std::endl;
         return cos_tensor;
     }
 
-    Tensor exp(const Tensor& tensor) { return ExpBackward(tensor); }
-    Tensor log(const Tensor& tensor) { return LogBackward(tensor); }
-    Tensor pow(const Tensor& tensor, unsigned int power) { return PowerBackward(tensor, power); }
+    Var AbsBackward(const Var& tensor) {
+        int sign = tensor.m_primal == 0 ? 0 : (tensor.m_primal > 0 ? 1 : -1);
+        Var abs_tensor{::fabs(tensor.m_primal), false};
+
+        abs_tensor.node_gradtape_index = GradientTape::instance().push_node(
+            OpKind::abs,
+            sign, tensor.node_gradtape_index);
+
+        return abs_tensor;
+    }
+
+    Var SqrtBackward(const Var& tensor) {
+        double primal = ::sqrt(tensor.m_primal);
+        Var sqrt_tensor{primal, false};
+
+        sqrt_tensor.node_gradtape_index = GradientTape::instance().push_node(
+            OpKind::sqrt,
+            0.5 / primal, tensor.node_gradtape_index);
+
+        return sqrt_tensor;
+    }
+
+    // Append the operation that produced `out` to the opcode stream of the active recorder, if any
+    static const Var& record_op_(const Var& out, OpKind kind, const Var& lhs, const Var& rhs, double constant=0.) {
+        if (OpRecorder* recorder = OpRecorder::active())
+            recorder->instructions.push_back({ kind, lhs.node_gradtape_index, rhs.node_gradtape_index, constant });
+        return out;
+    }
+
+    static const Var& record_op_(const Var& out, OpKind kind, const Var& operand, double constant=0.) {
+        if (OpRecorder* recorder = OpRecorder::active())
+            recorder->instructions.push_back({ kind, operand.node_gradtape_index, out.node_gradtape_index, constant });
+        return out;
+    }
+
+    static bool record_guard_(CmpKind cmp, const Var& lhs, const Var& rhs) {
+        bool outcome = compare(cmp, lhs.m_primal, rhs.m_primal);
+        if (OpRecorder* recorder = OpRecorder::active())
+            recorder->guards.push_back({ cmp, lhs.node_gradtape_index, rhs.node_gradtape_index, outcome });
+        return outcome;
+    }
+
+    Var::Var(double primal, bool is_leaf) : m_primal{primal} {
+        if (!is_leaf) return;
+        this->node_gradtape_index = GradientTape::instance().push_leaf_node();
+        record_op_(*this, OpKind::leaf, *this, primal);
+    }
+
+    Gradient Var::backward() const { return GradientTape::instance().backward(this->node_gradtape_index); }
+
+    const Var& Var::operator+=(const Var& v) { return *this = *this + v; }
+
+    Var operator+(const Var& l, const Var& r) {
+        profiler::OpTimer timer(OpKind::add);
+        return record_op_(AddBackward(l, r), OpKind::add, l, r);
+    }
+    Var operator-(const Var& l, const Var& r) {
+        profiler::OpTimer timer(OpKind::sub);
+        return record_op_(SubBackward(l, r), OpKind::sub, l, r);
+    }
+    Var operator-(const Var& v) { return Var(0.) - v; }
+    Var operator*(const Var& l, const Var& r) {
+        profiler::OpTimer timer(OpKind::mul);
+        return record_op_(MultBackward(l, r), OpKind::mul, l, r);
+    }
+    Var operator/(const Var& l, const Var& r) {
+        profiler::OpTimer timer(OpKind::div);
+        return record_op_(DivBackward(l, r), OpKind::div, l, r);
+    }
+
+    bool operator<(const Var& l, const Var& r) { return record_guard_(CmpKind::lt, l, r); }
+    bool operator<=(const Var& l, const Var& r) { return record_guard_(CmpKind::le, l, r); }
+    bool operator>(const Var& l, const Var& r) { return record_guard_(CmpKind::gt, l, r); }
+    bool operator>=(const Var& l, const Var& r) { return record_guard_(CmpKind::ge, l, r); }
+    bool operator==(const Var& l, const Var& r) { return record_guard_(CmpKind::eq, l, r); }
+    bool operator!=(const Var& l, const Var& r) { return record_guard_(CmpKind::ne, l, r); }
 
-    Tensor sin(const Tensor& tensor) { return SinBackward(tensor); }
-    Tensor cos(const Tensor& tensor) { return CosBackward(tensor); }
+    Var exp(const Var& tensor) {
+        profiler::OpTimer timer(OpKind::exp);
+        return record_op_(ExpBackward(tensor), OpKind::exp, tensor);
+    }
+    Var log(const Var& tensor) {
+        profiler::OpTimer timer(OpKind::log);
+        return record_op_(LogBackward(tensor), OpKind::log, tensor);
+    }
+    Var power(const Var& tensor, double power) {
+        profiler::OpTimer timer(OpKind::power);
+        return record_op_(PowerBackward(tensor, power), OpKind::power, tensor, power);
+    }
+    Var abs(const Var& tensor) {
+        profiler::OpTimer timer(OpKind::abs);
+        return record_op_(AbsBackward(tensor), OpKind::abs, tensor);
+    }
+    Var sqrt(const Var& tensor) {
+        profiler::OpTimer timer(OpKind::sqrt);
+        return record_op_(SqrtBackward(tensor), OpKind::sqrt, tensor);
+    }
+
+    Var sin(const Var& tensor) {
+        profiler::OpTimer timer(OpKind::sin);
+        return record_op_(SinBackward(tensor), OpKind::sin, tensor);
+    }
+    Var cos(const Var& tensor) {
+        profiler::OpTimer timer(OpKind::cos);
+        return record_op_(CosBackward(tensor), OpKind::cos, tensor);
+    }
 } // namespace nabla
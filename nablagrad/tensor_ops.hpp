@@ -1,22 +1,25 @@
 #ifndef TENSOR_OPS_H
 #define TENSOR_OPS_H
 
-#include "tensor.hpp"
+#include "var.hpp"
 
 #include <cmath>
 
 namespace nabla {
-    Tensor AddBackward(const Tensor& ltensor, const Tensor& rtensor);
-    Tensor SubBackward(const Tensor& ltensor, const Tensor& rtensor);
-    Tensor MultBackward(const Tensor& ltensor, const Tensor& rtensor);
-    Tensor DivBackward(const Tensor& ltensor, const Tensor& rtensor);
+    Var AddBackward(const Var& ltensor, const Var& rtensor);
+    Var SubBackward(const Var& ltensor, const Var& rtensor);
+    Var MultBackward(const Var& ltensor, const Var& rtensor);
+    Var DivBackward(const Var& ltensor, const Var& rtensor);
 
-    Tensor ExpBackward(const Tensor& tensor);
-    Tensor LogBackward(const Tensor& tensor);
-    Tensor PowerBackward(const Tensor& tensor, unsigned int power);
+    Var ExpBackward(const Var& tensor);
+    Var LogBackward(const Var& tensor);
+    Var PowerBackward(const Var& tensor, double power);
 
-    Tensor SinBackward(const Tensor& tensor);
-    Tensor CosBackward(const Tensor& tensor);
+    Var SinBackward(const Var& tensor);
+    Var CosBackward(const Var& tensor);
+
+    Var AbsBackward(const Var& tensor);
+    Var SqrtBackward(const Var& tensor);
 
 } // namespace nabla
 
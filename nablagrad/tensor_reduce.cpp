@@ -0,0 +1,363 @@
+#include "tensor_kernels.hpp"
+#include "cpu_features.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+namespace nabla {
+    namespace kernels {
+        namespace {
+            // Contiguous sums are split in halves down to blocks of this many elements, each summed
+            // in SIMD lanes: the error grows with log(n / block) instead of n
+            constexpr size_t pairwise_block = 128;
+            // Reductions of at least this many elements are split across threads
+            constexpr size_t parallel_reduce_elements = 1 << 20;
+            // Reductions across rows need rows of at least this many elements; narrower ones are
+            // copied to a contiguous layout first
+            constexpr size_t min_column_width = 16;
+
+            constexpr double lowest = -std::numeric_limits<double>::infinity();
+
+            // Whether `x` replaces `best` as the maximum: NaN beats every number, and the first
+            // maximum (or NaN) is kept
+            inline bool beats_(double x, double best) { return x > best || (std::isnan(x) && !std::isnan(best)); }
+            inline double max_(double m, double x) { return beats_(x, m) ? x : m; }
+
+            double sum_block_scalar_(const double* x, size_t n, bool squares) {
+                double s[4] = {};
+                size_t i = 0;
+                for (; i + 4 <= n; i += 4)
+                    for (size_t l = 0; l < 4; ++l) s[l] += squares ? x[i + l] * x[i + l] : x[i + l];
+                double r = (s[0] + s[1]) + (s[2] + s[3]);
+                for (; i < n; ++i) r += squares ? x[i] * x[i] : x[i];
+                return r;
+            }
+
+            double max_run_scalar_(const double* x, size_t n) {
+                double m = lowest;
+                for (size_t i = 0; i < n; ++i) m = max_(m, x[i]);
+                return m;
+            }
+
+            // Kahan-compensated sum[j] += x[j] (or x[j]^2); the running error is kept in comp[j]
+            void kahan_row_scalar_(const double* x, size_t n, double* sum, double* comp, bool squares) {
+                for (size_t j = 0; j < n; ++j) {
+                    double y = (squares ? x[j] * x[j] : x[j]) - comp[j];
+                    double t = sum[j] + y;
+                    comp[j] = (t - sum[j]) - y;
+                    sum[j] = t;
+                }
+            }
+
+            void max_row_scalar_(const double* x, size_t n, double* m) {
+                for (size_t j = 0; j < n; ++j) m[j] = max_(m[j], x[j]);
+            }
+
+#ifdef NABLA_SIMD_DISPATCH
+            NABLA_TARGET_AVX2 inline double hsum_(__m256d v) {
+                __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+                return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+            }
+
+            // Lane-wise max(m, x) where the first NaN wins
+            NABLA_TARGET_AVX2 inline __m256d max_v_(__m256d m, __m256d x) {
+                __m256d take = _mm256_or_pd(_mm256_cmp_pd(x, m, _CMP_GT_OQ),
+                                            _mm256_andnot_pd(_mm256_cmp_pd(m, m, _CMP_UNORD_Q), _mm256_cmp_pd(x, x, _CMP_UNORD_Q)));
+                return _mm256_blendv_pd(m, x, take);
+            }
+
+            NABLA_TARGET_AVX2 double sum_block_avx2_(const double* x, size_t n, bool squares) {
+                __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+                size_t i = 0;
+                if (squares) {
+                    for (; i + 8 <= n; i += 8) {
+                        __m256d v0 = _mm256_loadu_pd(x + i), v1 = _mm256_loadu_pd(x + i + 4);
+                        a0 = _mm256_fmadd_pd(v0, v0, a0);
+                        a1 = _mm256_fmadd_pd(v1, v1, a1);
+                    }
+                } else {
+                    for (; i + 8 <= n; i += 8) {
+                        a0 = _mm256_add_pd(a0, _mm256_loadu_pd(x + i));
+                        a1 = _mm256_add_pd(a1, _mm256_loadu_pd(x + i + 4));
+                    }
+                }
+                double r = hsum_(_mm256_add_pd(a0, a1));
+                for (; i < n; ++i) r += squares ? x[i] * x[i] : x[i];
+                return r;
+            }
+
+            NABLA_TARGET_AVX2 double max_run_avx2_(const double* x, size_t n) {
+                __m256d m0 = _mm256_set1_pd(lowest), m1 = m0;
+                size_t i = 0;
+                for (; i + 8 <= n; i += 8) {
+                    m0 = max_v_(m0, _mm256_loadu_pd(x + i));
+                    m1 = max_v_(m1, _mm256_loadu_pd(x + i + 4));
+                }
+                double lanes[8];
+                _mm256_storeu_pd(lanes, m0);
+                _mm256_storeu_pd(lanes + 4, m1);
+                double m = lowest;
+                for (double v : lanes) m = max_(m, v);
+                for (; i < n; ++i) m = max_(m, x[i]);
+                return m;
+            }
+
+            NABLA_TARGET_AVX2 void kahan_row_avx2_(const double* x, size_t n, double* sum, double* comp, bool squares) {
+                size_t j = 0;
+                for (; j + 4 <= n; j += 4) {
+                    __m256d s = _mm256_loadu_pd(sum + j), c = _mm256_loadu_pd(comp + j), v = _mm256_loadu_pd(x + j);
+                    __m256d y = squares ? _mm256_fmsub_pd(v, v, c) : _mm256_sub_pd(v, c);
+                    __m256d t = _mm256_add_pd(s, y);
+                    _mm256_storeu_pd(comp + j, _mm256_sub_pd(_mm256_sub_pd(t, s), y));
+                    _mm256_storeu_pd(sum + j, t);
+                }
+                kahan_row_scalar_(x + j, n - j, sum + j, comp + j, squares);
+            }
+
+            NABLA_TARGET_AVX2 void max_row_avx2_(const double* x, size_t n, double* m) {
+                size_t j = 0;
+                for (; j + 4 <= n; j += 4)
+                    _mm256_storeu_pd(m + j, max_v_(_mm256_loadu_pd(m + j), _mm256_loadu_pd(x + j)));
+                max_row_scalar_(x + j, n - j, m + j);
+            }
+#endif
+
+            double sum_block_(const double* x, size_t n, bool squares) {
+#ifdef NABLA_SIMD_DISPATCH
+                if (cpu::has_avx2()) return sum_block_avx2_(x, n, squares);
+#endif
+                return sum_block_scalar_(x, n, squares);
+            }
+
+            // The `n` elements at `x` as doubles: `x` itself, or floats widened into `buffer`
+            template<typename T>
+            const double* widen_(const T* x, size_t n, double* buffer) {
+                if constexpr (std::is_same<T, double>::value) {
+                    return x;
+                } else {
+                    std::copy(x, x + n, buffer);
+                    return buffer;
+                }
+            }
+
+            template<typename T>
+            double sum_pairwise_(const T* x, size_t n, bool squares) {
+                if (n <= pairwise_block) {
+                    double buffer[pairwise_block];
+                    return sum_block_(widen_(x, n, buffer), n, squares);
+                }
+                size_t half = (n / 2 + pairwise_block - 1) / pairwise_block * pairwise_block;
+                return sum_pairwise_(x, half, squares) + sum_pairwise_(x + half, n - half, squares);
+            }
+
+            double max_run_(const double* x, size_t n) {
+#ifdef NABLA_SIMD_DISPATCH
+                if (cpu::has_avx2()) return max_run_avx2_(x, n);
+#endif
+                return max_run_scalar_(x, n);
+            }
+
+            double max_run_(const float* x, size_t n) {
+                double m = lowest, buffer[pairwise_block];
+                for (size_t i = 0; i < n; i += pairwise_block) {
+                    size_t len = std::min(pairwise_block, n - i);
+                    m = max_(m, max_run_(widen_(x + i, len, buffer), len));
+                }
+                return m;
+            }
+
+            // Index of the first maximum (or first NaN) of a contiguous run
+            template<typename T>
+            size_t argmax_run_(const T* x, size_t n) {
+                double m = max_run_(x, n);
+                if (std::isnan(m)) return size_t(std::find_if(x, x + n, [](T v) { return std::isnan(v); }) - x);
+                return size_t(std::find(x, x + n, m) - x);
+            }
+
+            void kahan_row_(const double* x, size_t n, double* sum, double* comp, bool squares) {
+#ifdef NABLA_SIMD_DISPATCH
+                if (cpu::has_avx2()) return kahan_row_avx2_(x, n, sum, comp, squares);
+#endif
+                kahan_row_scalar_(x, n, sum, comp, squares);
+            }
+
+            void max_row_(const double* x, size_t n, double* m) {
+#ifdef NABLA_SIMD_DISPATCH
+                if (cpu::has_avx2()) return max_row_avx2_(x, n, m);
+#endif
+                max_row_scalar_(x, n, m);
+            }
+
+            void argmax_row_(const double* x, size_t n, double* best, double* index, size_t r) {
+                for (size_t j = 0; j < n; ++j) {
+                    if (beats_(x[j], best[j])) {
+                        best[j] = x[j];
+                        index[j] = double(r);
+                    }
+                }
+            }
+
+            template<typename T>
+            double run_(ReduceOp op, const T* x, size_t n) {
+                switch (op) {
+                    case ReduceOp::sum: return sum_pairwise_(x, n, false);
+                    case ReduceOp::sum_squares: return sum_pairwise_(x, n, true);
+                    case ReduceOp::max: return max_run_(x, n);
+                    case ReduceOp::argmax: return double(argmax_run_(x, n));
+                }
+                return 0.;
+            }
+
+            // A single long contiguous run reduced by all threads: the run is cut into chunks
+            // whose results are combined (pairwise for sums)
+            template<typename T>
+            double run_parallel_(ReduceOp op, const T* x, size_t n) {
+                size_t num_chunks = 4 * parallel::default_num_threads();
+                size_t chunk = ((n + num_chunks - 1) / num_chunks + pairwise_block - 1) / pairwise_block * pairwise_block;
+                num_chunks = (n + chunk - 1) / chunk;
+                std::vector<double> partial(num_chunks);
+                ReduceOp chunk_op = op == ReduceOp::argmax ? ReduceOp::max : op;
+                parallel::for_chunks(num_chunks, 0, 1, [&](size_t, size_t begin, size_t end) {
+                    for (size_t c = begin; c < end; ++c)
+                        partial[c] = run_(chunk_op, x + c * chunk, std::min(chunk, n - c * chunk));
+                });
+
+                if (op == ReduceOp::sum || op == ReduceOp::sum_squares) return sum_pairwise_(partial.data(), num_chunks, false);
+                size_t best = 0;
+                for (size_t c = 1; c < num_chunks; ++c)
+                    if (beats_(partial[c], partial[best])) best = c;
+                if (op == ReduceOp::max) return partial[best];
+                return double(best * chunk + argmax_run_(x + best * chunk, std::min(chunk, n - best * chunk)));
+            }
+
+            // Offset of the `index`-th element (row-major) of dimensions [begin, end)
+            size_t offset_(const std::vector<size_t>& shape, const std::vector<size_t>& stride,
+                           size_t begin, size_t end, size_t index) {
+                size_t offset = 0;
+                for (size_t d = end; d-- > begin;) {
+                    offset += index % shape[d] * stride[d];
+                    index /= shape[d];
+                }
+                return offset;
+            }
+
+            // Whether dimensions [begin, end) are laid out row-major without gaps
+            bool is_dense_(const std::vector<size_t>& shape, const std::vector<size_t>& stride, size_t begin, size_t end) {
+                size_t expected = 1;
+                for (size_t d = end; d-- > begin;) {
+                    if (shape[d] != 1 && stride[d] != expected) return false;
+                    expected *= shape[d];
+                }
+                return true;
+            }
+        } // namespace
+
+        template<typename T, typename D>
+        void reduce(ReduceOp op, const T* src, const std::vector<size_t>& shape,
+                    const std::vector<size_t>& stride, size_t kept, D* dst) {
+            size_t nd = shape.size();
+            size_t outer = 1, inner = 1;
+            for (size_t d = 0; d < nd; ++d) (d < kept ? outer : inner) *= shape[d];
+            if (outer == 0) return;
+            if (inner == 0) {
+                if (op == ReduceOp::max || op == ReduceOp::argmax)
+                    throw std::invalid_argument("reduce: max of an empty set of elements");
+                std::fill(dst, dst + outer, D(0));
+                return;
+            }
+
+            size_t num_threads = outer * inner >= parallel_reduce_elements ? parallel::default_num_threads() : 1;
+
+            if (is_dense_(shape, stride, kept, nd)) {
+                // each output reduces a contiguous run
+                if (num_threads == 1 || outer >= 4 * num_threads) {
+                    parallel::for_chunks(outer, num_threads, 0, [&](size_t, size_t begin, size_t end) {
+                        for (size_t o = begin; o < end; ++o) dst[o] = D(run_(op, src + offset_(shape, stride, 0, kept, o), inner));
+                    });
+                } else {
+                    for (size_t o = 0; o < outer; ++o) dst[o] = D(run_parallel_(op, src + offset_(shape, stride, 0, kept, o), inner));
+                }
+                return;
+            }
+
+            if (outer < min_column_width || !is_dense_(shape, stride, 0, kept)) {
+                std::vector<T> buffer(outer * inner);
+                copy_to_contiguous(src, shape, stride, buffer.data());
+                std::vector<size_t> dense(nd);
+                for (size_t d = nd, current = 1; d-- > 0;) {
+                    dense[d] = current;
+                    current *= shape[d];
+                }
+                reduce(op, buffer.data(), shape, dense, kept, dst);
+                return;
+            }
+
+            // The outputs are contiguous in the source (e.g. a reduction over the first dimension):
+            // reduce across rows, each row holding one element of every output. `acc` holds the
+            // running sums or maxima of outputs [begin, end), `aux` the Kahan compensations or the
+            // indices of the maxima.
+            auto reduce_rows = [&](size_t r_begin, size_t r_end, size_t begin, size_t end, double* acc, double* aux) {
+                std::fill(acc, acc + (end - begin), (op == ReduceOp::max || op == ReduceOp::argmax) ? lowest : 0.);
+                std::fill(aux, aux + (end - begin), 0.);
+                std::vector<double> buffer(std::is_same<T, double>::value ? 0 : end - begin);
+                for (size_t r = r_begin; r < r_end; ++r) {
+                    const double* row = widen_(src + offset_(shape, stride, kept, nd, r) + begin, end - begin, buffer.data());
+                    switch (op) {
+                        case ReduceOp::sum: kahan_row_(row, end - begin, acc, aux, false); break;
+                        case ReduceOp::sum_squares: kahan_row_(row, end - begin, acc, aux, true); break;
+                        case ReduceOp::max: max_row_(row, end - begin, acc); break;
+                        case ReduceOp::argmax: argmax_row_(row, end - begin, acc, aux, r); break;
+                    }
+                }
+            };
+            auto finish = [&](const double* acc, const double* aux, size_t begin, size_t end) {
+                for (size_t j = begin; j < end; ++j) {
+                    double a = acc[j - begin], x = aux[j - begin];
+                    dst[j] = D(op == ReduceOp::argmax ? x : (op == ReduceOp::max ? a : a - x));
+                }
+            };
+
+            if (num_threads == 1 || outer >= 1024 * num_threads) {
+                // split the outputs across threads
+                parallel::for_chunks(outer, num_threads, 0, [&](size_t, size_t begin, size_t end) {
+                    std::vector<double> acc(end - begin), aux(end - begin);
+                    reduce_rows(0, inner, begin, end, acc.data(), aux.data());
+                    finish(acc.data(), aux.data(), begin, end);
+                });
+                return;
+            }
+
+            // few outputs: split the rows across threads, then combine the partial results in
+            // row order (so that argmax still finds the first maximum)
+            size_t num_parts = std::min(inner, num_threads);
+            std::vector<double> acc(num_parts * outer), aux(num_parts * outer);
+            parallel::for_chunks(num_parts, num_threads, 1, [&](size_t, size_t begin, size_t end) {
+                for (size_t part = begin; part < end; ++part)
+                    reduce_rows(inner * part / num_parts, inner * (part + 1) / num_parts, 0, outer,
+                                acc.data() + part * outer, aux.data() + part * outer);
+            });
+            for (size_t part = 1; part < num_parts; ++part) {
+                double* a = acc.data() + part * outer;
+                double* x = aux.data() + part * outer;
+                for (size_t j = 0; j < outer; ++j) {
+                    if (op == ReduceOp::sum || op == ReduceOp::sum_squares) {
+                        acc[j] = (acc[j] - aux[j]) + (a[j] - x[j]);
+                        aux[j] = 0.;
+                    } else if (beats_(a[j], acc[j])) {
+                        acc[j] = a[j];
+                        aux[j] = x[j];
+                    }
+                }
+            }
+            finish(acc.data(), aux.data(), 0, outer);
+        }
+
+        template void reduce(ReduceOp, const double*, const std::vector<size_t>&, const std::vector<size_t>&, size_t, double*);
+        template void reduce(ReduceOp, const float*, const std::vector<size_t>&, const std::vector<size_t>&, size_t, float*);
+        template void reduce(ReduceOp, const float*, const std::vector<size_t>&, const std::vector<size_t>&, size_t, double*);
+    } // namespace kernels
+} // namespace nabla
@@ -0,0 +1,63 @@
+#ifndef VAR_H
+#define VAR_H
+
+#include <iostream>
+#include <vector>
+
+#include "gradient_tape.hpp"
+
+namespace nabla {
+    using Gradient = std::vector<double>;
+
+    // Scalar variable for reverse-mode automatic differentiation. Every `Var` is a node in the
+    // active gradient tape of the thread that created it (see `GradientTape::instance()`): leaf
+    // variables are pushed as leaf nodes on construction, and every operation on variables pushes
+    // a new node recording the local gradients wrt its operands (see `tensor_ops.cpp`). Calling
+    // `backward()` on the output of a computation sweeps the tape in reverse, returning the
+    // adjoint of every node in the tape.
+    struct Var {
+        // `is_leaf` should only be false for variables created by a tape operation, which set
+        // `node_gradtape_index` themselves.
+        Var(double primal=0., bool is_leaf=true);
+
+        double get_primal() const { return this->m_primal; }
+
+        // Reverse sweep of the gradient tape seeded from this variable. The result is indexed by
+        // tape node; the derivative wrt a variable `x` is at `x.node_gradtape_index`.
+        Gradient backward() const;
+
+        const Var& operator+=(const Var& v);
+
+        friend Var operator+(const Var& l, const Var& r);
+        friend Var operator-(const Var& l, const Var& r);
+        friend Var operator-(const Var& v);
+        friend Var operator*(const Var& l, const Var& r);
+        friend Var operator/(const Var& l, const Var& r);
+
+        // Comparisons of primal values. They are recorded as branch guards by `TapedFunction`.
+        friend bool operator<(const Var& l, const Var& r);
+        friend bool operator<=(const Var& l, const Var& r);
+        friend bool operator>(const Var& l, const Var& r);
+        friend bool operator>=(const Var& l, const Var& r);
+        friend bool operator==(const Var& l, const Var& r);
+        friend bool operator!=(const Var& l, const Var& r);
+
+        friend Var sin(const Var& v);
+        friend Var cos(const Var& v);
+        friend Var exp(const Var& v);
+        friend Var log(const Var& v);
+        friend Var abs(const Var& v);
+        friend Var power(const Var& v, double pow);
+        friend Var sqrt(const Var& v);
+
+        friend std::ostream& operator<<(std::ostream& os, const Var& v) {
+            os << "nabla::Var[primal: " << v.m_primal << ", node_gradtape_index: " << v.node_gradtape_index << "]";
+            return os;
+        }
+
+        double m_primal;
+        node_index_t node_gradtape_index = -1;
+    };
+} // namespace nabla
+
+#endif